@@ -0,0 +1,124 @@
+/* Structure-of-arrays storage for atom positions, types and grain ids.
+ *
+ * Author: Josh Vita
+ * Created: 2017/7
+ * Last edited: 2017/7
+ */
+
+#include <vector>
+#include <cstddef>
+#include "define.h"
+#include "Atoms.h"
+
+using namespace std;
+
+void Atoms::reserve(size_t n) {
+    /* Reserves storage for 'n' atoms in every column */
+
+    x.reserve(n);
+    y.reserve(n);
+    z.reserve(n);
+    type.reserve(n);
+    grain.reserve(n);
+}
+
+void Atoms::resize(size_t n) {
+    /* Resizes every column to 'n' atoms; new atoms have no grain (-1) */
+
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+    type.resize(n);
+    grain.resize(n, -1);
+}
+
+void Atoms::clear() {
+    /* Removes all atoms but keeps the allocated storage */
+
+    x.clear();
+    y.clear();
+    z.clear();
+    type.clear();
+    grain.clear();
+}
+
+void Atoms::push_back(int t, double px, double py, double pz, int g) {
+    /* Appends a single atom
+     *
+     * Args:
+     *  t       -   atom type
+     *  px,py,pz-   cartesian coordinates
+     *  g       -   grain id (-1 if not yet assigned)
+     */
+
+    x.push_back(px);
+    y.push_back(py);
+    z.push_back(pz);
+    type.push_back(t);
+    grain.push_back(g);
+}
+
+void Atoms::push_back(const AtomView &src, size_t i) {
+    /* Appends atom 'i' of another view */
+
+    push_back(src.type[i], src.x[i], src.y[i], src.z[i], src.grain[i]);
+}
+
+void Atoms::append(const AtomView &src) {
+    /* Appends every atom of 'src' to the end of the container
+     *
+     * Args:
+     *  src     -   atoms to copy; must not alias this container
+     */
+
+    x.insert(x.end(), src.x, src.x+src.n);
+    y.insert(y.end(), src.y, src.y+src.n);
+    z.insert(z.end(), src.z, src.z+src.n);
+    type.insert(type.end(), src.type, src.type+src.n);
+    grain.insert(grain.end(), src.grain, src.grain+src.n);
+}
+
+AtomView Atoms::view() {
+    /* Returns a view over all atoms. Invalidated by any resize. */
+
+    return AtomView {x.data(), y.data(), z.data(), type.data(), grain.data(),
+                        size()};
+}
+
+AtomView Atoms::view(size_t first, size_t count) {
+    /* Returns a view over atoms [first, first+count) */
+
+    return view().slice(first, count);
+}
+
+Atoms Atoms::fromArray(const vector<dvec_t> &arr, int g) {
+    /* Builds a container from the old [type,x,y,z] row format
+     *
+     * Args:
+     *  arr     -   array of atoms WITH atom types
+     *  g       -   grain id assigned to every atom
+     */
+
+    Atoms atoms;
+    atoms.reserve(arr.size());
+
+    for (vector<dvec_t>::size_type i=0; i<arr.size(); i++) {
+        atoms.push_back(static_cast<int>(arr[i][0]), arr[i][1], arr[i][2],
+                        arr[i][3], g);
+    }
+
+    return atoms;
+}
+
+vector<dvec_t> Atoms::toArray() const {
+    /* Converts back to the [type,x,y,z] row format */
+
+    vector<dvec_t> arr;
+    arr.reserve(size());
+
+    for (size_t i=0; i<size(); i++) {
+        arr.push_back(dvec_t {static_cast<double>(type[i]), x[i], y[i], z[i]});
+    }
+
+    return arr;
+}
@@ -0,0 +1,65 @@
+#ifndef ATOMS_H
+#define ATOMS_H
+
+#include <vector>
+#include <cstddef>
+#include "define.h"
+
+using namespace std;
+
+/* Non-owning view over a contiguous block of atoms in an Atoms container.
+ * Cheap to copy; passing one around never touches the atom data itself.
+ */
+struct AtomView {
+    double *x;
+    double *y;
+    double *z;
+    int *type;
+    int *grain;
+    size_t n;
+
+    size_t size() const { return n; }
+
+    AtomView slice(size_t first, size_t count) const {
+        return AtomView {x+first, y+first, z+first, type+first, grain+first,
+                            count};
+    }
+};
+
+/* Structure-of-arrays atom container. Each per-atom quantity lives in its own
+ * contiguous array so that whole-grain operations stream through memory
+ * instead of chasing one heap allocation per atom.
+ */
+struct Atoms {
+    vector<double> x;
+    vector<double> y;
+    vector<double> z;
+    vector<int> type;
+    vector<int> grain;
+
+    size_t size() const { return x.size(); }
+
+    bool empty() const { return x.empty(); }
+
+    void reserve(size_t);
+
+    void resize(size_t);
+
+    void clear();
+
+    void push_back(int, double, double, double, int grain=-1);
+
+    void push_back(const AtomView&, size_t);
+
+    void append(const AtomView&);
+
+    AtomView view();
+
+    AtomView view(size_t, size_t);
+
+    static Atoms fromArray(const vector<dvec_t>&, int grain=-1);
+
+    vector<dvec_t> toArray() const;
+};
+
+#endif
@@ -0,0 +1,170 @@
+/* Reading the realizations of a batch run.
+ *
+ * Author: Josh Vita
+ * Created: 2017/7
+ * Last edited: 2017/7
+ */
+
+#include <vector>
+#include <string>
+#include <set>
+#include <sstream>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+#include "Batch.h"
+
+using namespace std;
+
+namespace {
+
+    // Most realizations one line may expand to
+    const uint64_t MAX_SEEDS = 1000000;
+
+    string replaceAll(string text, const string &key, const string &value) {
+        for (size_t at=text.find(key); at!=string::npos;
+                at=text.find(key, at + value.size()))
+            text.replace(at, key.size(), value);
+
+        return text;
+    }
+
+    bool readSeeds(const string &word, uint64_t &first, uint64_t &last) {
+        /* Parses 'n' or 'first-last' */
+
+        size_t dash = word.find('-');
+        size_t used = 0;
+
+        try {
+            if (word.empty() || word[0] == '-')
+                return false;
+
+            first = stoull(word, &used);
+
+            if (dash == string::npos) {
+                last = first;
+                return used == word.size();
+            }
+
+            if (used != dash || dash+1 >= word.size() || word[dash+1] == '-')
+                return false;
+
+            last = stoull(word.substr(dash+1), &used);
+            return used == word.size() - dash - 1 && first <= last;
+        } catch (const exception&) {
+            return false;
+        }
+    }
+}
+
+namespace Batch {
+
+    void parse(const string &line, vector<Job> &jobs) {
+        /* Appends the realizations of one job line; blank and comment lines
+         * add nothing
+         *
+         * Args:
+         *  line    -   "side latConst grains seeds output"
+         *  jobs    -   receives one job per seed
+         *
+         * Throws:
+         *  invalid_argument if the line is malformed, or names one output
+         *  for several seeds
+         */
+
+        istringstream in(line.substr(0, line.find('#')));
+        string word;
+        vector<string> words;
+
+        while (in >> word)
+            words.push_back(word);
+
+        if (words.empty())
+            return;
+
+        Job job;
+        uint64_t first = 0, last = 0;
+        size_t used[3] = {0, 0, 0};
+        bool ok = words.size() == 5;
+
+        try {
+            if (ok) {
+                job.side = stod(words[0], &used[0]);
+                job.latConst = stod(words[1], &used[1]);
+                job.grains = stoi(words[2], &used[2]);
+            }
+        } catch (const exception&) {
+            ok = false;
+        }
+
+        ok = ok && used[0] == words[0].size() && used[1] == words[1].size() &&
+                used[2] == words[2].size() && job.side > 0 &&
+                job.latConst > 0 && job.latConst <= job.side &&
+                job.grains > 0 && readSeeds(words[3], first, last) &&
+                last - first < MAX_SEEDS;
+
+        if (!ok)
+            throw invalid_argument("bad job '" + line + "'; expected 'side "
+                                    "latConst grains seeds output'");
+
+        if (first != last && words[4].find("{seed}") == string::npos)
+            throw invalid_argument("job '" + line + "' has several seeds "
+                                    "but no {seed} in its output name");
+
+        string output = replaceAll(words[4], "{side}", words[0]);
+        output = replaceAll(output, "{grains}", words[2]);
+
+        for (uint64_t seed=first; ; seed++) {
+            job.seed = seed;
+            job.output = replaceAll(output, "{seed}", to_string(seed));
+            jobs.push_back(job);
+
+            if (seed == last)
+                break;
+        }
+    }
+
+    vector<Job> read(string filename) {
+        /* Reads a job file, one job line per line
+         *
+         * Throws:
+         *  runtime_error if the file cannot be read
+         *  invalid_argument for a bad line, with its line number
+         */
+
+        ifstream in(filename.c_str());
+
+        if (!in)
+            throw runtime_error("cannot open " + filename + " for reading");
+
+        vector<Job> jobs;
+        string line;
+
+        for (int number=1; getline(in, line); number++) {
+            try {
+                parse(line, jobs);
+            } catch (const invalid_argument &e) {
+                throw invalid_argument(filename + ":" + to_string(number) +
+                                        ": " + e.what());
+            }
+        }
+
+        return jobs;
+    }
+
+    void check(const vector<Job> &jobs) {
+        /* Makes sure no two realizations write the same file
+         *
+         * Throws:
+         *  invalid_argument naming the first file written twice
+         */
+
+        set<string> seen;
+
+        for (size_t j=0; j<jobs.size(); j++) {
+            if (!seen.insert(jobs[j].output).second)
+                throw invalid_argument("more than one realization writes " +
+                                        jobs[j].output);
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+using namespace std;
+
+/* Realizations generated in one run, read from a job file or the command
+ * line. Every job line is
+ *
+ *  side  latConst  grains  seeds  output
+ *
+ * where 'seeds' is one seed or an inclusive range 'first-last', giving one
+ * realization per seed. In 'output', {seed}, {side} and {grains} are
+ * replaced by the values of each realization; text after '#' is a comment.
+ * For example, 100 realizations each of two box sizes:
+ *
+ *  40  3.6  20  1-100  small_{seed}.data.gz
+ *  80  3.6  160 1-100  large_{seed}.data.gz
+ */
+namespace Batch {
+
+    struct Job {
+        double side;
+        double latConst;
+        int grains;
+        uint64_t seed;
+        string output;
+    };
+
+    void parse(const string&, vector<Job>&);
+
+    vector<Job> read(string);
+
+    void check(const vector<Job>&);
+}
+
+#endif
@@ -0,0 +1,354 @@
+/* Reading and writing the native binary format.
+ *
+ * Author: Josh Vita
+ * Created: 2017/7
+ * Last edited: 2017/7
+ */
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Atoms.h"
+#include "Tools.h"
+#include "Lammps.h"
+#include "Binary.h"
+
+using namespace std;
+
+namespace {
+
+    // Atoms per block when converting a whole file
+    const size_t CONVERT_BLOCK = 1 << 20;
+
+    // Bytes of a block of n atoms
+    uint64_t blockBytes(uint64_t n) {
+        return 3*sizeof(double)*n + 2*sizeof(int32_t)*n;
+    }
+
+    void put(FILE *file, const void *data, size_t bytes) {
+        if (fwrite(data, 1, bytes, file) != bytes)
+            throw runtime_error("failed to write binary file");
+    }
+}
+
+namespace Binary {
+
+    void Writer::open(string filename, const Tools::Box &box) {
+        /* Creates the file and writes a header without counts
+         *
+         * Args:
+         *  filename    -   name of output file
+         *  box         -   simulation box
+         *
+         * Throws:
+         *  runtime_error if the file cannot be created
+         */
+
+        file = fopen(filename.c_str(), "wb");
+
+        if (!file)
+            throw runtime_error("cannot open " + filename + " for writing");
+
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+
+        const double lo[3] = {box.lo.x, box.lo.y, box.lo.z};
+        const double len[3] = {box.len.x, box.len.y, box.len.z};
+        const double tilt[3] = {box.xy, box.xz, box.yz};
+
+        copy(lo, lo+3, header.lo);
+        copy(len, len+3, header.len);
+        copy(tilt, tilt+3, header.tilt);
+
+        index.clear();
+
+        put(file, &header, sizeof(header));
+    }
+
+    void Writer::write(const AtomView &arr) {
+        /* Appends a chunk of atoms as one block, with an index entry for
+         * every run of atoms of the same grain
+         *
+         * Throws:
+         *  runtime_error if writing fails
+         */
+
+        if (arr.size() == 0)
+            return;
+
+        uint64_t block = sizeof(header) + header.nAtoms*blockBytes(1);
+
+        for (size_t first=0; first<arr.size(); ) {
+            size_t last = first;
+
+            while (last < arr.size() && arr.grain[last] == arr.grain[first])
+                last++;
+
+            index.push_back(Run {arr.grain[first], block, arr.size(), first,
+                                    last - first});
+            first = last;
+        }
+
+        for (size_t i=0; i<arr.size(); i++)
+            header.nTypes = max<int64_t>(header.nTypes, arr.type[i]);
+
+        // The columns are written as they are; int is int32 here
+        static_assert(sizeof(int) == sizeof(int32_t), "int is not 32 bits");
+
+        put(file, arr.x, arr.size()*sizeof(double));
+        put(file, arr.y, arr.size()*sizeof(double));
+        put(file, arr.z, arr.size()*sizeof(double));
+        put(file, arr.type, arr.size()*sizeof(int32_t));
+        put(file, arr.grain, arr.size()*sizeof(int32_t));
+
+        header.nAtoms += arr.size();
+    }
+
+    void Writer::close() {
+        /* Writes the index and fills in the header
+         *
+         * Throws:
+         *  runtime_error if the end of the file cannot be written
+         */
+
+        header.nRuns = index.size();
+        header.indexOffset = sizeof(header) + header.nAtoms*blockBytes(1);
+
+        bool ok = fwrite(index.data(), sizeof(Run), index.size(), file) ==
+                    index.size();
+
+        ok = ok && fseek(file, 0, SEEK_SET) == 0 &&
+                fwrite(&header, sizeof(header), 1, file) == 1;
+
+        ok = (fclose(file) == 0) && ok;
+        file = nullptr;
+
+        if (!ok)
+            throw runtime_error("failed to finish binary file");
+    }
+
+    File::File() : data(nullptr), size(0), index(nullptr) {}
+
+    File::~File() {
+        close();
+    }
+
+    void File::open(string filename) {
+        /* Maps a file and checks its header and index. Nothing is read
+         * until atoms are used.
+         *
+         * Throws:
+         *  runtime_error if the file cannot be mapped or is not a binary
+         *  file of this version
+         */
+
+        close();
+
+        int fd = ::open(filename.c_str(), O_RDONLY);
+
+        if (fd < 0)
+            throw runtime_error("cannot open " + filename + " for reading");
+
+        struct stat info;
+
+        if (fstat(fd, &info) != 0 ||
+                static_cast<size_t>(info.st_size) < sizeof(Header)) {
+            ::close(fd);
+            throw runtime_error(filename + " is not a binary pv3d file");
+        }
+
+        size = info.st_size;
+        void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                        fd, 0);
+        ::close(fd);
+
+        if (p == MAP_FAILED) {
+            size = 0;
+            throw runtime_error("cannot map " + filename);
+        }
+
+        data = static_cast<char*>(p);
+        memcpy(&header, data, sizeof(header));
+
+        bool ok = memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                    header.version == VERSION &&
+                    header.indexOffset <= size &&
+                    header.nRuns <= (size - header.indexOffset)/sizeof(Run);
+
+        if (ok) {
+            index = reinterpret_cast<const Run*>(data + header.indexOffset);
+
+            for (uint64_t r=0; r<header.nRuns && ok; r++) {
+                ok = index[r].first + index[r].count <= index[r].blockAtoms &&
+                        index[r].block + blockBytes(index[r].blockAtoms) <=
+                        header.indexOffset;
+            }
+        }
+
+        if (!ok) {
+            close();
+            throw runtime_error(filename + " is not a binary pv3d file of "
+                                "version " + to_string(VERSION));
+        }
+    }
+
+    void File::close() {
+        if (data)
+            munmap(data, size);
+
+        data = nullptr;
+        size = 0;
+        index = nullptr;
+    }
+
+    Tools::Box File::box() const {
+        return Tools::Box {Tools::Vec3 {header.lo[0], header.lo[1],
+                                        header.lo[2]},
+                            Tools::Vec3 {header.len[0], header.len[1],
+                                        header.len[2]},
+                            header.tilt[0], header.tilt[1], header.tilt[2]};
+    }
+
+    AtomView File::run(size_t r) {
+        /* The atoms of index entry r, in place in the mapping */
+
+        const Run &e = index[r];
+        char *block = data + e.block;
+        uint64_t n = e.blockAtoms;
+
+        double *x = reinterpret_cast<double*>(block);
+        int *type = reinterpret_cast<int*>(block + 3*sizeof(double)*n);
+
+        return AtomView {x + e.first, x + n + e.first, x + 2*n + e.first,
+                            type + e.first, type + n + e.first, e.count};
+    }
+
+    vector<size_t> File::runsOf(int g) const {
+        /* Index entries of grain g, in file order */
+
+        vector<size_t> runs;
+
+        for (uint64_t r=0; r<header.nRuns; r++) {
+            if (index[r].grain == g)
+                runs.push_back(r);
+        }
+
+        return runs;
+    }
+
+    Atoms File::grain(int g) {
+        /* Copy of the atoms of grain g, in file order */
+
+        vector<size_t> runs = runsOf(g);
+        size_t n = 0;
+
+        for (size_t r=0; r<runs.size(); r++)
+            n += index[runs[r]].count;
+
+        Atoms atoms;
+        atoms.reserve(n);
+
+        for (size_t r=0; r<runs.size(); r++)
+            atoms.append(run(runs[r]));
+
+        return atoms;
+    }
+
+    Atoms File::atoms() {
+        /* Copy of every atom, in file order */
+
+        Atoms atoms;
+        atoms.reserve(header.nAtoms);
+
+        for (uint64_t r=0; r<header.nRuns; r++)
+            atoms.append(run(r));
+
+        return atoms;
+    }
+
+    bool isBinary(string filename) {
+        /* Whether a file starts like a binary pv3d file */
+
+        FILE *file = fopen(filename.c_str(), "rb");
+
+        if (!file)
+            return false;
+
+        char magic[sizeof(MAGIC)];
+        bool ok = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+                    memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+
+        fclose(file);
+
+        return ok;
+    }
+
+    void toLammps(string in, string out, int precision, int threads) {
+        /* Converts a binary file to a LAMMPS data file, compressed if
+         * 'out' ends in .gz
+         *
+         * Args:
+         *  in          -   binary file
+         *  out         -   data file to write
+         *  precision   -   digits after the decimal point
+         *  threads     -   threads to format with
+         */
+
+        File file;
+        file.open(in);
+
+        Lammps::Writer writer;
+        writer.open(out, file.box(), precision, threads);
+
+        // Runs of a block are adjacent, so whole blocks go out at once
+        for (uint64_t r=0; r<file.header.nRuns; ) {
+            uint64_t next = r+1;
+
+            while (next < file.header.nRuns &&
+                    file.index[next].block == file.index[r].block)
+                next++;
+
+            AtomView view = file.run(r);
+            view.n = file.index[next-1].first + file.index[next-1].count -
+                        file.index[r].first;
+
+            writer.write(view);
+            r = next;
+        }
+
+        writer.close();
+    }
+
+    void fromLammps(string in, string out, int threads) {
+        /* Converts a LAMMPS data file to a binary file. Data files carry no
+         * grains, so every atom has grain -1; charges are dropped.
+         *
+         * Args:
+         *  in      -   data file in 'atomic' or 'charge' style
+         *  out     -   binary file to write
+         *  threads -   threads to parse with
+         */
+
+        Lammps::Data data;
+        Lammps::readData(in, data, threads);
+
+        Writer writer;
+        writer.open(out, data.box);
+
+        for (size_t first=0; first<data.atoms.size(); first+=CONVERT_BLOCK) {
+            writer.write(data.atoms.view(first, min(CONVERT_BLOCK,
+                                            data.atoms.size() - first)));
+        }
+
+        writer.close();
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef BINARY_H
+#define BINARY_H
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include "Atoms.h"
+#include "Tools.h"
+
+using namespace std;
+
+/* Native binary container for generated structures, in the byte order of
+ * the machine writing it. The layout is
+ *
+ *  Header                      fixed size, at offset 0
+ *  blocks                      one per chunk written: the x, y and z
+ *                              columns (double), then type and grain (int32)
+ *  Run[nRuns]                  index, at header.indexOffset
+ *
+ * Atom ids are implied by the order of the blocks, as in a LAMMPS file
+ * written chunk by chunk. Every run of atoms of one grain within a block
+ * has an entry in the index, so a grain can be found without reading any
+ * other atoms, and its columns used straight from the mapped file.
+ */
+namespace Binary {
+
+    const char MAGIC[8] = {'P', 'V', '3', 'D', 'B', 'I', 'N', '\0'};
+    const uint64_t VERSION = 1;
+
+    struct Header {
+        char magic[8];
+        uint64_t version;
+        uint64_t nAtoms;
+        uint64_t nRuns;
+        uint64_t indexOffset;       // byte offset of the run index
+        int64_t nTypes;
+        double lo[3];
+        double len[3];
+        double tilt[3];             // xy, xz, yz
+    };
+
+    // Atoms [first, first+count) of the block at byte offset 'block',
+    // all of one grain
+    struct Run {
+        int64_t grain;
+        uint64_t block;
+        uint64_t blockAtoms;
+        uint64_t first;
+        uint64_t count;
+    };
+
+    /* Writes a file chunk by chunk, like Lammps::Writer; the index and the
+     * counts are written by close()
+     */
+    struct Writer {
+        FILE *file;
+        Header header;
+        vector<Run> index;
+
+        void open(string, const Tools::Box&);
+
+        void write(const AtomView&);
+
+        void close();
+    };
+
+    /* A file mapped into memory. Views point into the mapping, which is
+     * private: changing atoms through them never reaches the file.
+     */
+    struct File {
+        char *data;
+        size_t size;
+        Header header;
+        const Run *index;
+
+        File();
+
+        ~File();
+
+        File(const File&) = delete;
+
+        File &operator=(const File&) = delete;
+
+        void open(string);
+
+        void close();
+
+        Tools::Box box() const;
+
+        AtomView run(size_t);
+
+        vector<size_t> runsOf(int) const;
+
+        Atoms grain(int);
+
+        Atoms atoms();
+    };
+
+    bool isBinary(string);
+
+    void toLammps(string, string, int precision=6, int threads=1);
+
+    void fromLammps(string, string, int threads=1);
+}
+
+#endif
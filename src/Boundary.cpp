@@ -0,0 +1,154 @@
+/* Distances from atoms to the boundary of their grain.
+ *
+ * Author: Josh Vita
+ * Created: 2017/7
+ * Last edited: 2017/7
+ */
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "Atoms.h"
+#include "Tools.h"
+#include "Voronoi.h"
+#include "Boundary.h"
+
+using namespace std;
+
+namespace {
+
+    double toFace(Tools::Vec3 p, const Voronoi::Cell &cell, size_t f) {
+        /* Distance from p to face f of a cell, a convex polygon: to its
+         * plane if the foot of p lies on it, else to its nearest edge */
+
+        const vector<int> &face = cell.faces[f];
+        Tools::Vec3 n = cell.faceNormal[f];
+        double h = cell.faceOffset[f] - Tools::dot(n, p);
+        Tools::Vec3 foot = p + n*h;
+
+        bool on = true;
+        double edge = numeric_limits<double>::infinity();
+
+        for (size_t v=0; v<face.size(); v++) {
+            Tools::Vec3 a = cell.vertices[face[v]];
+            Tools::Vec3 e = cell.vertices[face[(v+1) % face.size()]] - a;
+
+            // Counter-clockwise seen from outside: the face is to the left
+            if (Tools::dot(Tools::cross(e, foot - a), n) < 0)
+                on = false;
+
+            double t = min(1.0, max(0.0, Tools::dot(p - a, e)/
+                                            Tools::norm2(e)));
+            edge = min(edge, Tools::norm2(p - (a + e*t)));
+        }
+
+        return on ? fabs(h) : sqrt(edge);
+    }
+
+    double acrossSelfContacts(Tools::Vec3 p, const Voronoi::Cell &cell,
+                                const Tools::Box &box) {
+        /* Distance from p to the faces shared with other grains of the cell
+         * and its 26 nearest periodic images, which the crystal runs on
+         * into through the self contacts */
+
+        const Tools::Vec3 a = {box.len.x, 0, 0};
+        const Tools::Vec3 b = {box.xy, box.len.y, 0};
+        const Tools::Vec3 c = {box.xz, box.yz, box.len.z};
+
+        double d = numeric_limits<double>::infinity();
+
+        for (int i=-1; i<=1; i++) {
+            for (int j=-1; j<=1; j++) {
+                for (int k=-1; k<=1; k++) {
+                    Tools::Vec3 q = p - (a*i + b*j + c*k);
+
+                    for (size_t f=0; f<cell.faces.size(); f++) {
+                        if (cell.faceNeighbor[f] != cell.id)
+                            d = min(d, toFace(q, cell, f));
+                    }
+                }
+            }
+        }
+
+        return d;
+    }
+}
+
+namespace Boundary {
+
+    void distances(const AtomView &arr, const vector<Voronoi::Cell> &cells,
+                    const Tools::Box &box, double *out) {
+        /* Distance from each atom to the nearest face its grain's Voronoi
+         * cell shares with another grain. The faces lie on the bisector
+         * planes between the grain's center and its neighbors', so in a
+         * cell that only meets other grains this is the distance to the
+         * nearest bisector, without searching the centers again.
+         *
+         * Faces where a grain meets its own periodic image are not
+         * boundaries: the crystal runs on across them, and the nearest
+         * bisector's foot may lie beyond one. Cells with such faces (few
+         * grains, small boxes) measure to the face polygons instead, over
+         * the nearest periodic images of the cell.
+         *
+         * Args:
+         *  arr     -   atoms; grain ids index 'cells'
+         *  cells   -   Voronoi cell of every grain
+         *  box     -   periodic simulation box
+         *  out     -   one distance per atom; 0 for atoms without a grain,
+         *              infinity in a grain that only meets itself
+         */
+
+        for (size_t i=0; i<arr.size(); i++) {
+            int g = arr.grain[i];
+
+            if (g < 0 || static_cast<size_t>(g) >= cells.size()) {
+                out[i] = 0.0;
+                continue;
+            }
+
+            const Voronoi::Cell &cell = cells[g];
+
+            // The image of the atom inside the (unwrapped) cell
+            Tools::Vec3 p = Tools::Vec3 {arr.x[i], arr.y[i], arr.z[i]};
+            p = cell.center + Tools::minImage(p - cell.center, box);
+
+            bool selfContact = false;
+            double d = numeric_limits<double>::infinity();
+
+            for (size_t f=0; f<cell.faceNormal.size(); f++) {
+                if (cell.faceNeighbor[f] == cell.id) {
+                    selfContact = true;
+                    continue;
+                }
+
+                d = min(d, cell.faceOffset[f] - Tools::dot(cell.faceNormal[f],
+                                                            p));
+            }
+
+            if (selfContact)
+                d = acrossSelfContacts(p, cell, box);
+
+            // Sites kept by the classifier may sit on a face up to round-off
+            out[i] = max(d, 0.0);
+        }
+    }
+
+    void tags(const AtomView &arr, const vector<Voronoi::Cell> &cells,
+                const Tools::Box &box, double within, double *out) {
+        /* 1 for atoms within 'within' of their grain's boundary, else 0
+         *
+         * Args:
+         *  arr     -   atoms; grain ids index 'cells'
+         *  cells   -   Voronoi cell of every grain
+         *  box     -   periodic simulation box
+         *  within  -   largest distance tagged
+         *  out     -   one tag per atom; 0 for atoms without a grain
+         */
+
+        distances(arr, cells, box, out);
+
+        for (size_t i=0; i<arr.size(); i++)
+            out[i] = (arr.grain[i] >= 0 && out[i] <= within) ? 1.0 : 0.0;
+    }
+}
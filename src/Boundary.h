@@ -0,0 +1,23 @@
+#ifndef BOUNDARY_H
+#define BOUNDARY_H
+
+#include <vector>
+#include "Atoms.h"
+#include "Tools.h"
+#include "Voronoi.h"
+
+using namespace std;
+
+/* Per-atom distance to the grain boundary, for analysing or tagging the
+ * boundary region of a generated structure.
+ */
+namespace Boundary {
+
+    void distances(const AtomView&, const vector<Voronoi::Cell>&,
+                    const Tools::Box&, double*);
+
+    void tags(const AtomView&, const vector<Voronoi::Cell>&,
+                const Tools::Box&, double, double*);
+}
+
+#endif
@@ -0,0 +1,398 @@
+/* Batched nearest-center classification of atoms. A brute-force scan over
+ * SoA center coordinates using squared distances; with a moderate number of
+ * grains this keeps the vector units busy and beats tree/grid lookups.
+ *
+ * Author: Josh Vita
+ * Created: 2017/7
+ * Last edited: 2017/7
+ */
+
+#include <vector>
+#include <cstddef>
+#include <limits>
+#include <cmath>
+#include "define.h"
+#include "Atoms.h"
+#include "Tools.h"
+#include "Grid.h"
+#include "Classify.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PV3D_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+    const size_t WIDTH = 4;         // doubles per AVX2 register
+    const double FAR = 1e150;       // padding; squares stay finite
+
+    size_t scanScalar(double px, double py, double pz,
+                        const Classify::Centers &c) {
+        /* Index of the closest point; ties go to the lower index */
+
+        double best = numeric_limits<double>::max();
+        size_t closest = 0;
+
+        for (size_t i=0; i<c.x.size(); i++) {
+            double dx = c.x[i]-px;
+            double dy = c.y[i]-py;
+            double dz = c.z[i]-pz;
+            double d2 = dx*dx + dy*dy + dz*dz;
+
+            if (d2 < best) {
+                best = d2;
+                closest = i;
+            }
+        }
+
+        return closest;
+    }
+
+    size_t scanScalarPeriodic(double px, double py, double pz,
+                                const Classify::Centers &c) {
+        /* Index of the closest center under the minimum image convention;
+         * ties go to the lower index */
+
+        const Tools::Box &b = c.box;
+        double ix = 1/b.len.x, iy = 1/b.len.y, iz = 1/b.len.z;
+
+        double best = numeric_limits<double>::max();
+        size_t closest = 0;
+
+        for (size_t i=0; i<c.x.size(); i++) {
+            double dx = c.x[i]-px;
+            double dy = c.y[i]-py;
+            double dz = c.z[i]-pz;
+
+            double n = floor(dz*iz + 0.5);
+            dz -= n*b.len.z;
+            dy -= n*b.yz;
+            dx -= n*b.xz;
+
+            n = floor(dy*iy + 0.5);
+            dy -= n*b.len.y;
+            dx -= n*b.xy;
+
+            n = floor(dx*ix + 0.5);
+            dx -= n*b.len.x;
+
+            double d2 = dx*dx + dy*dy + dz*dz;
+
+            if (d2 < best) {
+                best = d2;
+                closest = i;
+            }
+        }
+
+        return closest;
+    }
+
+#ifdef PV3D_X86
+    __attribute__((target("avx2")))
+    size_t reduceLanes(__m256d best, __m256d bestIdx) {
+        /* Picks the winning lane; each holds its lowest index on ties */
+
+        double d[WIDTH];
+        double k[WIDTH];
+        _mm256_storeu_pd(d, best);
+        _mm256_storeu_pd(k, bestIdx);
+
+        size_t lane = 0;
+
+        for (size_t l=1; l<WIDTH; l++) {
+            if (d[l] < d[lane] || (d[l] == d[lane] && k[l] < k[lane]))
+                lane = l;
+        }
+
+        return static_cast<size_t>(k[lane]);
+    }
+
+    __attribute__((target("avx2")))
+    size_t scanAvx2(double px, double py, double pz,
+                        const Classify::Centers &c) {
+        /* Same as scanScalar, four centers at a time. Multiplies and adds
+         * are kept separate (no FMA) so both paths agree bit for bit. */
+
+        __m256d vx = _mm256_set1_pd(px);
+        __m256d vy = _mm256_set1_pd(py);
+        __m256d vz = _mm256_set1_pd(pz);
+
+        __m256d best = _mm256_set1_pd(numeric_limits<double>::max());
+        __m256d bestIdx = _mm256_setzero_pd();
+        __m256d idx = _mm256_set_pd(3, 2, 1, 0);
+        const __m256d step = _mm256_set1_pd(WIDTH);
+
+        for (size_t i=0; i<c.x.size(); i+=WIDTH) {
+            __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(&c.x[i]), vx);
+            __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(&c.y[i]), vy);
+            __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(&c.z[i]), vz);
+
+            __m256d d2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx),
+                                        _mm256_mul_pd(dy, dy)),
+                                        _mm256_mul_pd(dz, dz));
+
+            __m256d closer = _mm256_cmp_pd(d2, best, _CMP_LT_OQ);
+            best = _mm256_blendv_pd(best, d2, closer);
+            bestIdx = _mm256_blendv_pd(bestIdx, idx, closer);
+            idx = _mm256_add_pd(idx, step);
+        }
+
+        return reduceLanes(best, bestIdx);
+    }
+
+    __attribute__((target("avx2")))
+    size_t scanAvx2Periodic(double px, double py, double pz,
+                                const Classify::Centers &c) {
+        /* Same as scanScalarPeriodic, four centers at a time */
+
+        const Tools::Box &b = c.box;
+
+        __m256d vx = _mm256_set1_pd(px);
+        __m256d vy = _mm256_set1_pd(py);
+        __m256d vz = _mm256_set1_pd(pz);
+
+        const __m256d lx = _mm256_set1_pd(b.len.x);
+        const __m256d ly = _mm256_set1_pd(b.len.y);
+        const __m256d lz = _mm256_set1_pd(b.len.z);
+        const __m256d ix = _mm256_set1_pd(1/b.len.x);
+        const __m256d iy = _mm256_set1_pd(1/b.len.y);
+        const __m256d iz = _mm256_set1_pd(1/b.len.z);
+        const __m256d xy = _mm256_set1_pd(b.xy);
+        const __m256d xz = _mm256_set1_pd(b.xz);
+        const __m256d yz = _mm256_set1_pd(b.yz);
+        const __m256d half = _mm256_set1_pd(0.5);
+
+        __m256d best = _mm256_set1_pd(numeric_limits<double>::max());
+        __m256d bestIdx = _mm256_setzero_pd();
+        __m256d idx = _mm256_set_pd(3, 2, 1, 0);
+        const __m256d step = _mm256_set1_pd(WIDTH);
+
+        for (size_t i=0; i<c.x.size(); i+=WIDTH) {
+            __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(&c.x[i]), vx);
+            __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(&c.y[i]), vy);
+            __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(&c.z[i]), vz);
+
+            __m256d n = _mm256_floor_pd(_mm256_add_pd(_mm256_mul_pd(dz, iz),
+                                                        half));
+            dz = _mm256_sub_pd(dz, _mm256_mul_pd(n, lz));
+            dy = _mm256_sub_pd(dy, _mm256_mul_pd(n, yz));
+            dx = _mm256_sub_pd(dx, _mm256_mul_pd(n, xz));
+
+            n = _mm256_floor_pd(_mm256_add_pd(_mm256_mul_pd(dy, iy), half));
+            dy = _mm256_sub_pd(dy, _mm256_mul_pd(n, ly));
+            dx = _mm256_sub_pd(dx, _mm256_mul_pd(n, xy));
+
+            n = _mm256_floor_pd(_mm256_add_pd(_mm256_mul_pd(dx, ix), half));
+            dx = _mm256_sub_pd(dx, _mm256_mul_pd(n, lx));
+
+            __m256d d2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx),
+                                        _mm256_mul_pd(dy, dy)),
+                                        _mm256_mul_pd(dz, dz));
+
+            __m256d closer = _mm256_cmp_pd(d2, best, _CMP_LT_OQ);
+            best = _mm256_blendv_pd(best, d2, closer);
+            bestIdx = _mm256_blendv_pd(bestIdx, idx, closer);
+            idx = _mm256_add_pd(idx, step);
+        }
+
+        return reduceLanes(best, bestIdx);
+    }
+#endif
+}
+
+namespace Classify {
+
+    bool haveAvx2() {
+        /* True if the running CPU can take the AVX2 path */
+
+#ifdef PV3D_X86
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        return avx2;
+#else
+        return false;
+#endif
+    }
+
+    Centers pack(const vector<Tools::Vec3> &points, const vector<int> &ids) {
+        /* Lays out a set of centers for nearest().
+         *
+         * Args:
+         *  points  -   center positions (for periodic cells, include images)
+         *  ids     -   grain id of every point
+         *
+         * Returns:
+         *  packed centers; cost of the early-exit radii is O(points^2)
+         */
+
+        Centers c;
+        c.n = points.size();
+        c.periodic = false;
+        c.box = Tools::Box {Tools::Vec3 {0,0,0}, Tools::Vec3 {0,0,0}, 0, 0, 0};
+
+        size_t padded = (c.n + WIDTH - 1)/WIDTH*WIDTH;
+
+        c.x.assign(padded, FAR);
+        c.y.assign(padded, FAR);
+        c.z.assign(padded, FAR);
+        c.id.assign(padded, -1);
+        c.safe2.assign(c.n, numeric_limits<double>::max());
+
+        for (size_t i=0; i<c.n; i++) {
+            c.x[i] = points[i].x;
+            c.y[i] = points[i].y;
+            c.z[i] = points[i].z;
+            c.id[i] = ids[i];
+        }
+
+        for (size_t i=0; i<c.n; i++) {
+            for (size_t j=i+1; j<c.n; j++) {
+                if (ids[i] == ids[j])
+                    continue;
+
+                double d2 = Tools::norm2(points[i]-points[j]) / 4.0;
+
+                if (d2 < c.safe2[i])
+                    c.safe2[i] = d2;
+                if (d2 < c.safe2[j])
+                    c.safe2[j] = d2;
+            }
+        }
+
+        return c;
+    }
+
+    Centers pack(const vector<Tools::Vec3> &centers, const Tools::Box &box) {
+        /* Lays out the N original centers of a periodic cell for nearest();
+         * grain ids are the indices into 'centers'. Images are never built;
+         * the scan applies the minimum image convention instead.
+         *
+         * Args:
+         *  centers -   grain centers
+         *  box     -   periodic cell (orthorhombic or triclinic)
+         *
+         * Returns:
+         *  packed centers; cost of the early-exit radii is O(centers^2)
+         */
+
+        Centers c;
+        c.n = centers.size();
+        c.periodic = true;
+        c.box = box;
+
+        size_t padded = (c.n + WIDTH - 1)/WIDTH*WIDTH;
+
+        // Padding is parked on a real center so the minimum image never
+        // pulls it closer than that center; the higher index loses ties
+        c.x.assign(padded, c.n ? centers[0].x : 0);
+        c.y.assign(padded, c.n ? centers[0].y : 0);
+        c.z.assign(padded, c.n ? centers[0].z : 0);
+        c.id.assign(padded, 0);
+        c.safe2.assign(c.n, numeric_limits<double>::max());
+
+        for (size_t i=0; i<c.n; i++) {
+            c.x[i] = centers[i].x;
+            c.y[i] = centers[i].y;
+            c.z[i] = centers[i].z;
+            c.id[i] = static_cast<int>(i);
+        }
+
+        for (size_t i=0; i<c.n; i++) {
+            for (size_t j=i+1; j<c.n; j++) {
+                Tools::Vec3 d = Tools::minImage(centers[i]-centers[j], box);
+                double d2 = Tools::norm2(d) / 4.0;
+
+                if (d2 < c.safe2[i])
+                    c.safe2[i] = d2;
+                if (d2 < c.safe2[j])
+                    c.safe2[j] = d2;
+            }
+        }
+
+        return c;
+    }
+
+    void nearest(const AtomView &atoms, const Centers &c, int *owner,
+                    int hint) {
+        /* Finds the owning grain of every atom in a block.
+         *
+         * Args:
+         *  atoms   -   block of atoms to classify
+         *  c       -   packed centers
+         *  owner   -   output; grain id of each atom (atoms.size() entries)
+         *  hint    -   index of the packed point the atoms were generated
+         *              around, or -1. Atoms inside its safe radius are
+         *              assigned to it without scanning.
+         */
+
+        if (c.n == 0) {
+            for (size_t a=0; a<atoms.size(); a++)
+                owner[a] = -1;
+            return;
+        }
+
+#ifdef PV3D_X86
+        bool avx2 = haveAvx2();
+#endif
+
+        double hx = 0, hy = 0, hz = 0, hSafe2 = -1;
+        int hId = -1;
+
+        if (hint >= 0) {
+            hx = c.x[hint];
+            hy = c.y[hint];
+            hz = c.z[hint];
+            hSafe2 = c.safe2[hint];
+            hId = c.id[hint];
+        }
+
+        for (size_t a=0; a<atoms.size(); a++) {
+            double px = atoms.x[a];
+            double py = atoms.y[a];
+            double pz = atoms.z[a];
+
+            if (hint >= 0) {
+                double dx = hx-px;
+                double dy = hy-py;
+                double dz = hz-pz;
+
+                // Strictly inside: no other grain can be as close
+                if (dx*dx + dy*dy + dz*dz < hSafe2) {
+                    owner[a] = hId;
+                    continue;
+                }
+            }
+
+            size_t closest;
+
+#ifdef PV3D_X86
+            if (avx2)
+                closest = c.periodic ? scanAvx2Periodic(px, py, pz, c) :
+                                        scanAvx2(px, py, pz, c);
+            else
+#endif
+                closest = c.periodic ? scanScalarPeriodic(px, py, pz, c) :
+                                        scanScalar(px, py, pz, c);
+
+            owner[a] = c.id[closest];
+        }
+    }
+
+    void nearest(const AtomView &atoms, const CenterGrid &grid, int *owner) {
+        /* Finds the owning grain of every atom in a block using the bucket
+         * grid; meant for large numbers of grains.
+         *
+         * Args:
+         *  atoms   -   block of atoms to classify
+         *  grid    -   bucket grid over the grain centers
+         *  owner   -   output; grain id of each atom (atoms.size() entries)
+         */
+
+        for (size_t a=0; a<atoms.size(); a++) {
+            owner[a] = grid.nearest(Tools::Vec3 {atoms.x[a], atoms.y[a],
+                                                    atoms.z[a]});
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef CLASSIFY_H
+#define CLASSIFY_H
+
+#include <vector>
+#include <cstddef>
+#include "define.h"
+#include "Atoms.h"
+#include "Tools.h"
+#include "Grid.h"
+
+using namespace std;
+
+namespace Classify {
+
+    /* Center coordinates in SoA layout, padded to a multiple of the vector
+     * width so the inner loop never needs a remainder step. Several points
+     * may share one grain id (e.g. the 27 periodic images of a center).
+     * Periodic centers are compared through the minimum image convention,
+     * so only the N original centers are stored.
+     */
+    struct Centers {
+        vector<double> x;
+        vector<double> y;
+        vector<double> z;
+        vector<int> id;
+
+        // Squared radius around each point inside which it certainly owns
+        // an atom: a quarter of the squared distance to the closest point
+        // with a different id
+        vector<double> safe2;
+
+        size_t n;
+
+        bool periodic;
+        Tools::Box box;
+    };
+
+    Centers pack(const vector<Tools::Vec3>&, const vector<int>&);
+
+    Centers pack(const vector<Tools::Vec3>&, const Tools::Box&);
+
+    void nearest(const AtomView&, const Centers&, int*, int hint=-1);
+
+    void nearest(const AtomView&, const CenterGrid&, int*);
+
+    bool haveAvx2();
+}
+
+#endif
@@ -10,9 +10,13 @@
 
 #include <vector>
 #include <cmath>
+#include <algorithm>
 #include "define.h"
 #include <iostream>
 #include "Tools.h"
+#include "Atoms.h"
+#include "Voronoi.h"
+#include "Grain.h"
 
 using namespace std;
 
@@ -63,6 +67,42 @@ namespace Grain {
         return trueCenter;
     }
 
+    Tools::Vec3 getGrainCenter(const AtomView &arr) {
+        /* Searches a block of atoms to get the true center of the grain by
+         * calculating the box dimension.
+         *
+         * Args:
+         *  arr    -    view of the atoms in the grain
+         */
+
+        double xlo=0,xhi=0;
+        double ylo=0,yhi=0;
+        double zlo=0,zhi=0;
+
+        for (size_t i=0; i<arr.size(); i++) {
+            if (arr.x[i]<xlo){
+                xlo = arr.x[i];
+            }else if (arr.x[i]>xhi){
+                xhi = arr.x[i];
+            }
+
+            if (arr.y[i]<ylo){
+                ylo = arr.y[i];
+            }else if (arr.y[i]>yhi){
+                yhi = arr.y[i];
+            }
+
+            if (arr.z[i]<zlo){
+                zlo = arr.z[i];
+            }else if (arr.z[i]>zhi){
+                zhi = arr.z[i];
+            }
+        }
+
+        return Tools::Vec3 {abs(xhi-xlo)/2.0, abs(yhi-ylo)/2.0,
+                                abs(zhi-zlo)/2.0};
+    }
+
     void shiftGrain(vector<dvec_t> &arr, dvec_t center) {
         /* Shifts an array of points to a new center
          *
@@ -79,6 +119,17 @@ namespace Grain {
         }
     }
 
+    void shiftGrain(AtomView arr, Tools::Vec3 center) {
+        /* Shifts a block of atoms to a new center in place
+         *
+         * Args:
+         *  arr    -    view of the atoms to be shifted
+         *  center -    new center
+         */
+
+        Tools::translate(arr, center);
+    }
+
     vector<dvec_t> genGrain(dvec_t dimensions, vector<dvec_t> basis,
                                 double latConst, double type) {
         /* Generates a grain of the given size, using the given basis. Note that
@@ -136,4 +187,211 @@ namespace Grain {
 
         return grain;
     }
+
+    void genGrain(Atoms &grain, Tools::Vec3 dimensions,
+                    const vector<dvec_t> &basis, double latConst, int type) {
+        /* Generates a grain of the given size, using the given basis, and
+         * appends it to 'grain'. Only the newly added atoms are centered on
+         * the origin, so several sublattices can be generated into the same
+         * container one after another.
+         *
+         * Args:
+         *  grain       -   container that receives the atoms
+         *  dimensions  -   xyz size of the grain (same units as latConst)
+         *  basis       -   the basis set in the format [x y z] (fractional
+         *                  coordinates)
+         *  latConst    -   the lattice constant of the unit cell
+         *  type        -   atom type
+         */
+
+        double diagLength = sqrt(Tools::norm2(dimensions));
+
+        int numCells = static_cast<int>(ceil(diagLength/latConst));
+
+        size_t first = grain.size();
+        size_t nBasis = basis.size();
+
+        grain.reserve(first + nBasis*numCells*numCells*numCells);
+
+        // Same ordering as the row-based version: z outermost, basis innermost
+        for (int k=0; k<numCells; k++) {
+            for (int j=0; j<numCells; j++) {
+                for (int i=0; i<numCells; i++) {
+                    for (size_t b=0; b<nBasis; b++) {
+                        grain.push_back(type,
+                                        basis[b][0]*latConst + i*latConst,
+                                        basis[b][1]*latConst + j*latConst,
+                                        basis[b][2]*latConst + k*latConst);
+                    }
+                }
+            }
+        }
+
+        AtomView added = grain.view(first, grain.size()-first);
+
+        shiftGrain(added, -getGrainCenter(added));
+    }
+
+    void cellPlanes(CellPlanes &planes, const Voronoi::Cell &cell,
+                    const Tools::Vec3 *step) {
+        /* Expresses the face planes of a cell in terms of lattice indices,
+         * with the lattice origin on the cell center. 'planes' is
+         * overwritten but keeps its storage, so a reused one does not
+         * allocate.
+         *
+         * Args:
+         *  planes  -   output
+         *  cell    -   Voronoi cell of the grain
+         *  step    -   the three (mutually orthogonal) lattice vectors in the
+         *              lab frame
+         */
+
+        const Tools::Vec3 c = cell.center;
+        const size_t nFaces = cell.faces.size();
+
+        planes.normal.assign(cell.faceNormal.begin(), cell.faceNormal.end());
+        planes.g.resize(nFaces);
+        planes.h.resize(nFaces);
+        planes.nCell = nFaces;
+
+        for (size_t f=0; f<nFaces; f++) {
+            Tools::Vec3 n = cell.faceNormal[f];
+
+            planes.g[f] = Tools::Vec3 {Tools::dot(n, step[0]),
+                                        Tools::dot(n, step[1]),
+                                        Tools::dot(n, step[2])};
+            planes.h[f] = cell.faceOffset[f] - Tools::dot(n, c);
+        }
+
+        // Range of unit cells touched by the cell, in the crystal frame
+        planes.lo = Tools::Vec3 {1e300, 1e300, 1e300};
+        planes.hi = Tools::Vec3 {-1e300, -1e300, -1e300};
+
+        for (size_t v=0; v<cell.vertices.size(); v++) {
+            Tools::Vec3 d = cell.vertices[v] - c;
+            Tools::Vec3 u = {Tools::dot(d, step[0])/Tools::norm2(step[0]),
+                                Tools::dot(d, step[1])/Tools::norm2(step[1]),
+                                Tools::dot(d, step[2])/Tools::norm2(step[2])};
+
+            planes.lo = Tools::Vec3 {min(planes.lo.x, u.x),
+                                        min(planes.lo.y, u.y),
+                                        min(planes.lo.z, u.z)};
+            planes.hi = Tools::Vec3 {max(planes.hi.x, u.x),
+                                        max(planes.hi.y, u.y),
+                                        max(planes.hi.z, u.z)};
+        }
+    }
+
+    void addClip(CellPlanes &planes, const Voronoi::Cell &cell,
+                    const Tools::Vec3 *step, const Tools::Box &region) {
+        /* Adds the six faces of an axis-aligned region as clip planes and
+         * shrinks the index box to the part of the cell inside the region.
+         *
+         * Args:
+         *  planes  -   planes of the cell, from cellPlanes
+         *  cell    -   Voronoi cell of the grain
+         *  step    -   the three lattice vectors in the lab frame
+         *  region  -   box [lo, lo+len), in the same (unwrapped) frame as
+         *              the cell
+         */
+
+        const Tools::Vec3 c = cell.center;
+        const Tools::Vec3 lo = region.lo;
+        const Tools::Vec3 hi = region.lo + region.len;
+
+        const Tools::Vec3 axes[3] = {{1,0,0}, {0,1,0}, {0,0,1}};
+        const double los[3] = {lo.x, lo.y, lo.z};
+        const double his[3] = {hi.x, hi.y, hi.z};
+
+        for (int d=0; d<3; d++) {
+            for (int side=0; side<2; side++) {
+                Tools::Vec3 n = side ? -axes[d] : axes[d];
+                double offset = side ? -los[d] : his[d];
+
+                planes.normal.push_back(n);
+                planes.g.push_back(Tools::Vec3 {Tools::dot(n, step[0]),
+                                                Tools::dot(n, step[1]),
+                                                Tools::dot(n, step[2])});
+                planes.h.push_back(offset - Tools::dot(n, c));
+            }
+        }
+
+        // Corners of the overlap of the region and the cell's bounding box
+        Tools::Vec3 a = {max(lo.x, cell.lo.x), max(lo.y, cell.lo.y),
+                            max(lo.z, cell.lo.z)};
+        Tools::Vec3 b = {min(hi.x, cell.hi.x), min(hi.y, cell.hi.y),
+                            min(hi.z, cell.hi.z)};
+
+        if (a.x > b.x || a.y > b.y || a.z > b.z) {
+            planes.lo = Tools::Vec3 {1, 1, 1};
+            planes.hi = Tools::Vec3 {0, 0, 0};
+            return;
+        }
+
+        Tools::Vec3 ilo = {1e300, 1e300, 1e300};
+        Tools::Vec3 ihi = {-1e300, -1e300, -1e300};
+
+        for (int corner=0; corner<8; corner++) {
+            Tools::Vec3 d = Tools::Vec3 {(corner & 1) ? b.x : a.x,
+                                            (corner & 2) ? b.y : a.y,
+                                            (corner & 4) ? b.z : a.z} - c;
+            Tools::Vec3 u = {Tools::dot(d, step[0])/Tools::norm2(step[0]),
+                                Tools::dot(d, step[1])/Tools::norm2(step[1]),
+                                Tools::dot(d, step[2])/Tools::norm2(step[2])};
+
+            ilo = Tools::Vec3 {min(ilo.x, u.x), min(ilo.y, u.y),
+                                min(ilo.z, u.z)};
+            ihi = Tools::Vec3 {max(ihi.x, u.x), max(ihi.y, u.y),
+                                max(ihi.z, u.z)};
+        }
+
+        planes.lo = Tools::Vec3 {max(planes.lo.x, ilo.x),
+                                    max(planes.lo.y, ilo.y),
+                                    max(planes.lo.z, ilo.z)};
+        planes.hi = Tools::Vec3 {min(planes.hi.x, ihi.x),
+                                    min(planes.hi.y, ihi.y),
+                                    min(planes.hi.z, ihi.z)};
+    }
+
+    void keepOwnCell(Atoms &atoms, const vector<int> &owner, int regionId,
+                        Tools::Vec3 center, const Tools::Box &box) {
+        /* Keeps the atoms that belong to the Voronoi tile 'regionId' and
+         * wraps them into the periodic box. A block wider than the box holds
+         * several periodic copies of the same site; only the copy at the
+         * minimum image displacement from the center survives, so every
+         * site is kept exactly once.
+         *
+         * Args:
+         *  atoms       -   atoms generated around 'center'; filtered in place
+         *  owner       -   owning grain id of every atom
+         *  regionId    -   tile id to keep
+         *  center      -   center of the tile
+         *  box         -   periodic cell
+         */
+
+        size_t kept = 0;
+
+        for (size_t a=0; a<atoms.size(); a++) {
+            if (owner[a] != regionId)
+                continue;
+
+            Tools::Vec3 d = {atoms.x[a]-center.x, atoms.y[a]-center.y,
+                                atoms.z[a]-center.z};
+            Tools::Vec3 m = Tools::minImage(d, box);
+
+            if (m.x != d.x || m.y != d.y || m.z != d.z)
+                continue;
+
+            Tools::Vec3 p = Tools::wrap(center + d, box);
+
+            atoms.x[kept] = p.x;
+            atoms.y[kept] = p.y;
+            atoms.z[kept] = p.z;
+            atoms.type[kept] = atoms.type[a];
+            atoms.grain[kept] = regionId;
+            kept++;
+        }
+
+        atoms.resize(kept);
+    }
 }
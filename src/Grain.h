@@ -2,14 +2,256 @@
 #define GRAIN_H
 
 #include "define.h"
+#include "Atoms.h"
+#include "Tools.h"
+#include "Voronoi.h"
+#include "Lattice.h"
 
 namespace Grain {
 
+    // Face planes of a Voronoi cell in terms of lattice indices (i,j,k):
+    // a site with basis offset b is inside face f when
+    // dot(g[f], (i,j,k)) <= h[f] - dot(normal[f], b). lo/hi is the index box
+    // spanned by the cell. Planes past the first nCell are clip planes of a
+    // region (see addClip), which only limit where sites are generated.
+    struct CellPlanes {
+        vector<Tools::Vec3> normal;
+        vector<Tools::Vec3> g;
+        vector<double> h;
+        size_t nCell;
+        Tools::Vec3 lo;
+        Tools::Vec3 hi;
+    };
+
     dvec_t getGrainCenter(vector<dvec_t>);
 
+    Tools::Vec3 getGrainCenter(const AtomView&);
+
     vector<dvec_t> genGrain(dvec_t, vector<dvec_t>, double, double);
 
+    void genGrain(Atoms&, Tools::Vec3, const vector<dvec_t>&, double, int);
+
+    // Per-thread work space of the grain generator. The buffers keep their
+    // capacity from grain to grain, so once they have grown to the largest
+    // grain, filling a grain allocates nothing but its output.
+    struct Scratch {
+        CellPlanes planes;
+        vector<double> hb;
+        Atoms edge;
+        vector<int> owner;
+    };
+
+    void cellPlanes(CellPlanes&, const Voronoi::Cell&, const Tools::Vec3*);
+
+    void addClip(CellPlanes&, const Voronoi::Cell&, const Tools::Vec3*,
+                    const Tools::Box&);
+
+    void keepOwnCell(Atoms&, const vector<int>&, int, Tools::Vec3,
+                        const Tools::Box&);
+
     void shiftGrain(vector<dvec_t>&, dvec_t);
+
+    void shiftGrain(AtomView, Tools::Vec3);
+
+    template<class L>
+    size_t expectedSites(double volume, double latConst) {
+        /* Number of lattice sites expected in 'volume', for sizing buffers;
+         * 0 unless both are positive */
+
+        if (!(volume > 0) || !(latConst > 0))
+            return 0;
+
+        double cellVolume = latConst*latConst*latConst*L::cell.x*L::cell.y*
+                            L::cell.z;
+
+        return static_cast<size_t>(volume/cellVolume*L::nSites);
+    }
+
+    inline bool rowRange(const CellPlanes &planes, const double *hb, int j,
+                            int k, double eps, double range[4]) {
+        /* Narrows the range of i along row (j,k) to the sites inside every
+         * face of a cell. Clip planes are loosened by eps in both ranges;
+         * callers apply the exact region test per site.
+         *
+         * Args:
+         *  planes  -   face planes of the cell
+         *  hb      -   per-face right-hand side for the basis site
+         *  eps     -   tolerance the planes are moved by
+         *  range   -   in: starting bounds in both pairs; out: [0,1] with the
+         *              planes pushed out by eps, [2,3] pulled in by eps
+         *
+         * Returns:
+         *  'false' if no site of the row can be in the cell
+         */
+
+        const double tiny = 1e-6*eps;
+
+        for (size_t f=0; f<planes.h.size() && range[0]<=range[1]; f++) {
+            double rhs = hb[f] - j*planes.g[f].y - k*planes.g[f].z;
+            double gx = planes.g[f].x;
+            double in = (f < planes.nCell) ? -eps : eps;
+
+            if (gx > tiny) {
+                range[1] = min(range[1], (rhs+eps)/gx);
+                range[3] = min(range[3], (rhs+in)/gx);
+            } else if (gx < -tiny) {
+                range[0] = max(range[0], (rhs+eps)/gx);
+                range[2] = max(range[2], (rhs+in)/gx);
+            } else if (rhs + eps < 0) {
+                range[0] = 1;
+                range[1] = 0;
+            } else if (rhs + in < 0) {
+                range[2] = 1;
+                range[3] = 0;
+            }
+        }
+
+        return range[0] <= range[1];
+    }
+
+    template<class L>
+    void genGrainInCell(Atoms &inside, Atoms &edge, const Voronoi::Cell &cell,
+                        double latConst, const int (&types)[L::nSub],
+                        const Tools::Mat3 &rotMat, const Tools::Box &box,
+                        const Tools::Box *clip=nullptr,
+                        Scratch *scratch=nullptr) {
+        /* Fills a Voronoi cell with a compile-time lattice (see Lattice.h).
+         * Only lattice sites that can fall inside the cell are visited: the
+         * cell is taken into the crystal frame, and for every row of unit
+         * cells the range of indices inside all face planes is solved for
+         * directly, so almost nothing generated is thrown away later. The
+         * basis is known at compile time, so each row is walked once and
+         * every sublattice is emitted from it in an unrolled inner loop,
+         * with the atom type assigned inline. The lattice origin sits on
+         * the grain center.
+         *
+         * Sites further than a small tolerance inside every face certainly
+         * belong to the grain; they go to 'inside', wrapped into the box and
+         * tagged with the grain id. Sites within the tolerance of a face go
+         * to 'edge', unwrapped and untagged (-1), to be settled by the
+         * nearest-center classifier.
+         *
+         * With 'clip', only sites whose unwrapped position lies in the
+         * half-open region [lo, lo+len) are generated, so a grain can be
+         * built piece by piece over disjoint regions.
+         *
+         * Args:
+         *  inside      -   receives sites that certainly belong to the cell
+         *  edge        -   receives sites on or near the cell boundary
+         *  cell        -   Voronoi cell of the grain
+         *  latConst    -   the lattice constant
+         *  types       -   atom type of each sublattice
+         *  rotMat      -   crystal to lab rotation of the grain
+         *  box         -   periodic cell used to wrap 'inside' atoms
+         *  clip        -   optional region to restrict the sites to
+         *  scratch     -   optional reusable work space
+         */
+
+        const int n = L::nSites;
+        const double eps = 1e-6*latConst;
+        const Tools::Vec3 c = cell.center;
+
+        const Tools::Vec3 len = L::cell;
+        Tools::Vec3 step[3] = {Tools::column(rotMat, 0)*(latConst*len.x),
+                                Tools::column(rotMat, 1)*(latConst*len.y),
+                                Tools::column(rotMat, 2)*(latConst*len.z)};
+
+        Tools::Vec3 offset[n];
+        int type[n];
+
+        for (int s=0; s<n; s++) {
+            offset[s] = step[0]*L::sites[s].x + step[1]*L::sites[s].y +
+                        step[2]*L::sites[s].z;
+            type[s] = types[L::sites[s].sub];
+        }
+
+        Scratch local;
+        Scratch &work = scratch ? *scratch : local;
+        CellPlanes &planes = work.planes;
+
+        cellPlanes(planes, cell, step);
+
+        Tools::Vec3 clipLo = {-1e300, -1e300, -1e300};
+        Tools::Vec3 clipHi = {1e300, 1e300, 1e300};
+
+        if (clip) {
+            addClip(planes, cell, step, *clip);
+            clipLo = clip->lo;
+            clipHi = clip->lo + clip->len;
+
+            if (planes.lo.x > planes.hi.x)
+                return;
+        }
+
+        const size_t nFaces = planes.h.size();
+
+        vector<double> &hb = work.hb;
+        hb.resize(n*nFaces);
+
+        for (int s=0; s<n; s++) {
+            for (size_t f=0; f<nFaces; f++) {
+                hb[s*nFaces+f] = planes.h[f] -
+                                    Tools::dot(planes.normal[f], offset[s]);
+            }
+        }
+
+        // Fractional offsets are in [0,1), so one extra cell covers them all
+        int k0 = static_cast<int>(floor(planes.lo.z)) - 1;
+        int k1 = static_cast<int>(ceil(planes.hi.z));
+        int j0 = static_cast<int>(floor(planes.lo.y)) - 1;
+        int j1 = static_cast<int>(ceil(planes.hi.y));
+        double i0 = floor(planes.lo.x) - 1;
+        double i1 = ceil(planes.hi.x);
+
+        double range[n][4];
+
+        for (int k=k0; k<=k1; k++) {
+            for (int j=j0; j<=j1; j++) {
+                double lo = i1+1, hi = i0-1;
+
+                for (int s=0; s<n; s++) {
+                    double *r = range[s];
+                    r[0] = r[2] = i0;
+                    r[1] = r[3] = i1;
+
+                    if (rowRange(planes, &hb[s*nFaces], j, k, eps, r)) {
+                        lo = min(lo, ceil(r[0]));
+                        hi = max(hi, floor(r[1]));
+                    }
+                }
+
+                if (lo > hi)
+                    continue;
+
+                Tools::Vec3 row = c + step[1]*j + step[2]*k;
+
+                for (int i=static_cast<int>(lo); i<=hi; i++) {
+                    Tools::Vec3 base = row + step[0]*i;
+
+                    for (int s=0; s<n; s++) {
+                        const double *r = range[s];
+
+                        if (i < r[0] || i > r[1])
+                            continue;
+
+                        Tools::Vec3 p = base + offset[s];
+
+                        if (p.x < clipLo.x || p.y < clipLo.y ||
+                                p.z < clipLo.z || p.x >= clipHi.x ||
+                                p.y >= clipHi.y || p.z >= clipHi.z)
+                            continue;
+
+                        if (i >= r[2] && i <= r[3]) {
+                            p = Tools::wrap(p, box);
+                            inside.push_back(type[s], p.x, p.y, p.z, cell.id);
+                        } else {
+                            edge.push_back(type[s], p.x, p.y, p.z);
+                        }
+                    }
+                }
+            }
+        }
+    }
 }
 
 #endif
@@ -0,0 +1,251 @@
+/* Periodic bucket grid for nearest-grain-center lookups.
+ *
+ * Author: Josh Vita
+ * Created: 2017/7
+ * Last edited: 2017/7
+ */
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "define.h"
+#include "Tools.h"
+#include "Grid.h"
+
+using namespace std;
+
+namespace {
+
+    double wrap(double x, double len) {
+        /* Maps 'x' into [0,len) */
+
+        double w = x - len*floor(x/len);
+
+        return (w >= len) ? 0.0 : w;
+    }
+
+    int floorDiv(int a, int n) {
+        /* Integer division rounding towards negative infinity */
+
+        return (a >= 0) ? a/n : -((-a + n - 1)/n);
+    }
+}
+
+int CenterGrid::bucket(int i, int j, int k) const {
+    /* Flattened index of bucket (i,j,k); indices must already be wrapped */
+
+    return (k*nb[1] + j)*nb[0] + i;
+}
+
+void CenterGrid::build(const vector<Tools::Vec3> &centers, Tools::Vec3 boxDims,
+                        double perBin) {
+    /* Sorts the centers into buckets sized to hold about 'perBin' centers
+     * each.
+     *
+     * Args:
+     *  centers     -   grain centers; the index is the grain id
+     *  boxDims     -   xyz size of the periodic box (origin as lower bound)
+     *  perBin      -   target number of centers per bucket
+     */
+
+    box = boxDims;
+
+    double volume = box.x*box.y*box.z;
+    double n = static_cast<double>(max<size_t>(centers.size(), 1));
+    double side = cbrt(volume*perBin/n);
+
+    double dims[3] = {box.x, box.y, box.z};
+
+    for (int d=0; d<3; d++) {
+        nb[d] = max(1, static_cast<int>(dims[d]/side));
+    }
+
+    width = Tools::Vec3 {box.x/nb[0], box.y/nb[1], box.z/nb[2]};
+
+    int nBins = nb[0]*nb[1]*nb[2];
+
+    // Counting sort of the centers into their buckets
+    vector<int> owner(centers.size());
+    binStart.assign(nBins+1, 0);
+
+    for (size_t c=0; c<centers.size(); c++) {
+        Tools::Vec3 w = {wrap(centers[c].x, box.x), wrap(centers[c].y, box.y),
+                            wrap(centers[c].z, box.z)};
+
+        int i = min(static_cast<int>(w.x/width.x), nb[0]-1);
+        int j = min(static_cast<int>(w.y/width.y), nb[1]-1);
+        int k = min(static_cast<int>(w.z/width.z), nb[2]-1);
+
+        owner[c] = bucket(i, j, k);
+        binStart[owner[c]+1]++;
+    }
+
+    for (int b=0; b<nBins; b++) {
+        binStart[b+1] += binStart[b];
+    }
+
+    vector<int> fill(binStart.begin(), binStart.end()-1);
+
+    cx.resize(centers.size());
+    cy.resize(centers.size());
+    cz.resize(centers.size());
+    id.resize(centers.size());
+
+    for (size_t c=0; c<centers.size(); c++) {
+        int slot = fill[owner[c]]++;
+
+        cx[slot] = wrap(centers[c].x, box.x);
+        cy[slot] = wrap(centers[c].y, box.y);
+        cz[slot] = wrap(centers[c].z, box.z);
+        id[slot] = static_cast<int>(c);
+    }
+}
+
+int CenterGrid::nearest(Tools::Vec3 p) const {
+    /* Returns the id of the center closest to 'p' under periodic boundary
+     * conditions */
+
+    double dist2;
+
+    return nearest(p, dist2);
+}
+
+int CenterGrid::nearest(Tools::Vec3 p, double &best) const {
+    /* Finds the center closest to 'p' under periodic boundary conditions.
+     * Buckets are visited in shells of growing radius around the bucket
+     * holding 'p'; once a shell is further away than the best match so far,
+     * nothing outside it can win. Exact ties go to the lower id.
+     *
+     * Args:
+     *  p       -   query point (any position; it is wrapped into the box)
+     *  best    -   set to the squared distance to the returned center
+     *
+     * Returns:
+     *  id of the closest center, or -1 if the grid is empty
+     */
+
+    best = numeric_limits<double>::max();
+    int closest = -1;
+
+    if (id.empty())
+        return closest;
+
+    Tools::Vec3 w = {wrap(p.x, box.x), wrap(p.y, box.y), wrap(p.z, box.z)};
+
+    int b[3];
+    b[0] = min(static_cast<int>(w.x/width.x), nb[0]-1);
+    b[1] = min(static_cast<int>(w.y/width.y), nb[1]-1);
+    b[2] = min(static_cast<int>(w.z/width.z), nb[2]-1);
+
+    double minWidth = min(width.x, min(width.y, width.z));
+    int rMax = max(nb[0], max(nb[1], nb[2]));
+
+    for (int r=0; r<=rMax; r++) {
+        for (int k=-r; k<=r; k++) {
+            int qz = floorDiv(b[2]+k, nb[2]);
+            int bz = b[2]+k - qz*nb[2];
+            double sz = qz*box.z;
+
+            for (int j=-r; j<=r; j++) {
+                int qy = floorDiv(b[1]+j, nb[1]);
+                int by = b[1]+j - qy*nb[1];
+                double sy = qy*box.y;
+
+                // Only the surface of the shell is new
+                bool inner = (abs(k) < r && abs(j) < r);
+                int step = inner ? 2*r : 1;
+
+                for (int i=-r; i<=r; i+=(r==0 ? 1 : step)) {
+                    int qx = floorDiv(b[0]+i, nb[0]);
+                    int bx = b[0]+i - qx*nb[0];
+                    double sx = qx*box.x;
+
+                    int bin = bucket(bx, by, bz);
+
+                    for (int c=binStart[bin]; c<binStart[bin+1]; c++) {
+                        double dx = cx[c]+sx - w.x;
+                        double dy = cy[c]+sy - w.y;
+                        double dz = cz[c]+sz - w.z;
+                        double d2 = dx*dx + dy*dy + dz*dz;
+
+                        if (d2 < best || (d2 == best && id[c] < closest)) {
+                            best = d2;
+                            closest = id[c];
+                        }
+                    }
+                }
+            }
+        }
+
+        // Everything not yet visited is at least r bucket widths away
+        double reach = r*minWidth;
+
+        if (closest >= 0 && best <= reach*reach)
+            break;
+    }
+
+    return closest;
+}
+
+void CenterGrid::within(Tools::Vec3 p, double r, vector<int> &ids,
+                        vector<Tools::Vec3> &disp) const {
+    /* Collects every periodic image of every center closer than 'r' to 'p'.
+     * A center can show up several times when 'r' exceeds half the box.
+     *
+     * Args:
+     *  p       -   query point
+     *  r       -   search radius
+     *  ids     -   output; center ids (cleared first)
+     *  disp    -   output; displacement from 'p' to each image
+     */
+
+    ids.clear();
+    disp.clear();
+
+    if (id.empty())
+        return;
+
+    Tools::Vec3 w = {wrap(p.x, box.x), wrap(p.y, box.y), wrap(p.z, box.z)};
+
+    int b[3];
+    b[0] = min(static_cast<int>(w.x/width.x), nb[0]-1);
+    b[1] = min(static_cast<int>(w.y/width.y), nb[1]-1);
+    b[2] = min(static_cast<int>(w.z/width.z), nb[2]-1);
+
+    int rx = static_cast<int>(ceil(r/width.x));
+    int ry = static_cast<int>(ceil(r/width.y));
+    int rz = static_cast<int>(ceil(r/width.z));
+
+    double r2 = r*r;
+
+    for (int k=-rz; k<=rz; k++) {
+        int qz = floorDiv(b[2]+k, nb[2]);
+        int bz = b[2]+k - qz*nb[2];
+        double sz = qz*box.z;
+
+        for (int j=-ry; j<=ry; j++) {
+            int qy = floorDiv(b[1]+j, nb[1]);
+            int by = b[1]+j - qy*nb[1];
+            double sy = qy*box.y;
+
+            for (int i=-rx; i<=rx; i++) {
+                int qx = floorDiv(b[0]+i, nb[0]);
+                int bx = b[0]+i - qx*nb[0];
+                double sx = qx*box.x;
+
+                int bin = bucket(bx, by, bz);
+
+                for (int c=binStart[bin]; c<binStart[bin+1]; c++) {
+                    Tools::Vec3 d = {cx[c]+sx - w.x, cy[c]+sy - w.y,
+                                        cz[c]+sz - w.z};
+
+                    if (Tools::norm2(d) < r2) {
+                        ids.push_back(id[c]);
+                        disp.push_back(d);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <vector>
+#include "define.h"
+#include "Tools.h"
+
+using namespace std;
+
+/* Periodic bucket grid over a set of grain centers. Built once; each query
+ * only looks at the buckets around the query point, so the cost of finding
+ * the owning grain stays flat as the number of grains grows.
+ *
+ * The box is periodic with its lower corner at the origin.
+ */
+struct CenterGrid {
+    Tools::Vec3 box;
+    Tools::Vec3 width;          // bucket edge lengths
+    int nb[3];                  // buckets along x, y, z
+
+    // Centers sorted by bucket; bucket b holds [binStart[b], binStart[b+1])
+    vector<int> binStart;
+    vector<double> cx;
+    vector<double> cy;
+    vector<double> cz;
+    vector<int> id;
+
+    void build(const vector<Tools::Vec3>&, Tools::Vec3, double perBin=2.0);
+
+    int nearest(Tools::Vec3) const;
+
+    int nearest(Tools::Vec3, double&) const;
+
+    void within(Tools::Vec3, double, vector<int>&, vector<Tools::Vec3>&) const;
+
+    int bucket(int, int, int) const;
+};
+
+#endif
@@ -8,19 +8,731 @@
 #include <vector>
 #include <string>
 #include <cstdio>
+#include <cstring>
+#include <charconv>
+#include <stdexcept>
+#include <atomic>
+#include <cstdarg>
+#include <algorithm>
+#include <cctype>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
 #include "define.h"
+#include "Atoms.h"
+#include "Tools.h"
+#include "Lammps.h"
+#include "Parallel.h"
 
 using namespace std;
 
+namespace {
+
+    // Widths of the count fields patched by Writer::close(); wide enough
+    // for any count that fits the type
+    const int ATOMS_WIDTH = 20;
+    const int TYPES_WIDTH = 10;
+
+    // Atoms formatted per task when a chunk is split across threads
+    const size_t BLOCK = 1 << 16;
+
+    // Text compressed per task into its own gzip member
+    const size_t GZ_BLOCK = 1 << 20;
+
+    void appendf(string &out, const char *format, ...) {
+        /* printf to the end of a string */
+
+        va_list args;
+        va_start(args, format);
+        char line[256];
+        int n = vsnprintf(line, sizeof(line), format, args);
+        va_end(args);
+
+        out.append(line, min(static_cast<size_t>(n), sizeof(line)-1));
+    }
+
+    string counts(size_t nAtoms, int nTypes) {
+        string text;
+        appendf(text, "%*zu atoms\n", ATOMS_WIDTH, nAtoms);
+        appendf(text, "%*d atom types\n", TYPES_WIDTH, nTypes);
+
+        return text;
+    }
+
+    bool endsWith(const string &s, const string &end) {
+        return s.size() >= end.size() &&
+                s.compare(s.size()-end.size(), end.size(), end) == 0;
+    }
+
+    void gzipMember(string &out, const char *data, size_t size, int level) {
+        /* Compresses 'data' into a complete gzip member. Members decompress
+         * independently and concatenate into one valid gzip file, so each
+         * can be made on its own thread. Level 0 stores the data, making
+         * the member's size depend only on 'size'.
+         *
+         * Throws:
+         *  runtime_error if zlib fails
+         */
+
+        z_stream z;
+        memset(&z, 0, sizeof(z));
+
+        // 16 added to the window bits asks for a gzip wrapper
+        if (deflateInit2(&z, level, Z_DEFLATED, 15+16, 8,
+                            Z_DEFAULT_STRATEGY) != Z_OK)
+            throw runtime_error("cannot start compression");
+
+        out.resize(deflateBound(&z, size));
+
+        z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        z.avail_in = size;
+        z.next_out = reinterpret_cast<Bytef*>(&out[0]);
+        z.avail_out = out.size();
+
+        int status = deflate(&z, Z_FINISH);
+        out.resize(z.total_out);
+        deflateEnd(&z);
+
+        if (status != Z_STREAM_END)
+            throw runtime_error("compression failed");
+    }
+
+    void writeBlocks(FILE *file, const vector<string> &blocks, int nBlocks,
+                        int threads) {
+        /* Writes the first nBlocks blocks at the end of the file. Several
+         * blocks get their offsets from their lengths and are written
+         * there in parallel.
+         *
+         * Throws:
+         *  runtime_error if writing fails
+         */
+
+        if (nBlocks == 0)
+            return;
+
+        if (nBlocks == 1) {
+            if (fwrite(blocks[0].data(), 1, blocks[0].size(), file) !=
+                    blocks[0].size())
+                throw runtime_error("failed to write atoms");
+
+            return;
+        }
+
+        vector<off_t> offset(nBlocks+1);
+
+        if (fflush(file) != 0)
+            throw runtime_error("failed to write atoms");
+
+        offset[0] = ftello(file);
+
+        for (int b=0; b<nBlocks; b++)
+            offset[b+1] = offset[b] + blocks[b].size();
+
+        int fd = fileno(file);
+        atomic<bool> failed(false);
+
+        Parallel::forEach(nBlocks, threads, [&](int b, int) {
+            const char *p = blocks[b].data();
+            size_t left = blocks[b].size();
+            off_t at = offset[b];
+
+            while (left > 0 && !failed) {
+                ssize_t n = pwrite(fd, p, left, at);
+
+                if (n <= 0) {
+                    failed = true;
+                    break;
+                }
+
+                p += n;
+                left -= n;
+                at += n;
+            }
+        });
+
+        if (failed || fseeko(file, offset[nBlocks], SEEK_SET) != 0)
+            throw runtime_error("failed to write atoms");
+    }
+
+    size_t lineBound(int precision) {
+        /* Longest atom line for coordinates below 1e16 in magnitude */
+
+        return 20 + 1 + 11 + 3*(1 + 1 + 16 + 1 + precision) + 1;
+    }
+
+    char *formatLine(char *p, char *end, size_t id, int type, double x,
+                        double y, double z, int precision) {
+        /* Writes "id type x y z\n" like "%zu %d %.*f %.*f %.*f\n". Returns
+         * the end of the line, or nullptr if it does not fit. */
+
+        const chars_format fixed = chars_format::fixed;
+        to_chars_result r = to_chars(p, end, id);
+
+        if (r.ec != errc() || r.ptr == end)
+            return nullptr;
+
+        *r.ptr++ = ' ';
+        r = to_chars(r.ptr, end, type);
+
+        const double xyz[3] = {x, y, z};
+
+        for (int d=0; d<3; d++) {
+            if (r.ec != errc() || r.ptr == end)
+                return nullptr;
+
+            *r.ptr++ = ' ';
+            r = to_chars(r.ptr, end, xyz[d], fixed, precision);
+        }
+
+        if (r.ec != errc() || r.ptr == end)
+            return nullptr;
+
+        *r.ptr++ = '\n';
+
+        return r.ptr;
+    }
+
+    char *formatComment(char *p, char *end, double value, int digits) {
+        /* Writes " # value\n" at p; nullptr if it does not fit */
+
+        if (end - p < 3)
+            return nullptr;
+
+        *p++ = ' ';
+        *p++ = '#';
+        *p++ = ' ';
+        to_chars_result r = to_chars(p, end, value, chars_format::fixed,
+                                        digits);
+
+        if (r.ec != errc() || r.ptr == end)
+            return nullptr;
+
+        *r.ptr++ = '\n';
+
+        return r.ptr;
+    }
+
+    // Read-only map of a whole file, unmapped when it goes out of scope
+    struct Mapped {
+        const char *data;
+        size_t size;
+
+        explicit Mapped(const string &filename) : data(nullptr), size(0) {
+            int fd = ::open(filename.c_str(), O_RDONLY);
+
+            if (fd < 0)
+                throw runtime_error("cannot open " + filename +
+                                    " for reading");
+
+            struct stat info;
+            bool ok = (fstat(fd, &info) == 0);
+
+            if (ok && info.st_size > 0) {
+                size = info.st_size;
+                void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                ok = (p != MAP_FAILED);
+
+                if (ok) {
+                    madvise(p, size, MADV_SEQUENTIAL);
+                    data = static_cast<const char*>(p);
+                }
+            }
+
+            ::close(fd);
+
+            if (!ok)
+                throw runtime_error("cannot map " + filename);
+        }
+
+        ~Mapped() {
+            if (data)
+                munmap(const_cast<char*>(data), size);
+        }
+
+        Mapped(const Mapped&) = delete;
+        Mapped &operator=(const Mapped&) = delete;
+    };
+
+    const char *nextLine(const char *p, const char *end) {
+        const void *nl = memchr(p, '\n', end - p);
+        return nl ? static_cast<const char*>(nl) + 1 : end;
+    }
+
+    const char *skipBlanks(const char *p, const char *end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+            p++;
+
+        return p;
+    }
+
+    const char *textEnd(const char *line, const char *end) {
+        /* End of a line without its comment and newline */
+
+        const void *hash = memchr(line, '#', end - line);
+        const char *stop = hash ? static_cast<const char*>(hash) : end;
+
+        while (stop > line && isspace(static_cast<unsigned char>(stop[-1])))
+            stop--;
+
+        return stop;
+    }
+
+    string words(const char *p, const char *end) {
+        /* The words of [p,end) separated by single spaces */
+
+        string out;
+
+        while ((p = skipBlanks(p, end)) < end) {
+            if (!out.empty())
+                out += ' ';
+
+            while (p < end && !isspace(static_cast<unsigned char>(*p)))
+                out += *p++;
+        }
+
+        return out;
+    }
+
+    template<class T>
+    bool readNumber(const char *&p, const char *end, T &value) {
+        /* Parses a number at p, after blanks, and moves p past it */
+
+        p = skipBlanks(p, end);
+
+        // from_chars takes no leading '+'
+        if (p < end && *p == '+')
+            p++;
+
+        from_chars_result r = from_chars(p, end, value);
+
+        if (r.ec != errc())
+            return false;
+
+        p = r.ptr;
+        return true;
+    }
+
+    const char *readHeader(const char *p, const char *end, Lammps::Data &data,
+                            size_t &nAtoms) {
+        /* Reads the header keywords of a data file, and finds the Atoms
+         * section. Other sections are skipped.
+         *
+         * Returns:
+         *  the first line after the Atoms keyword, or 'end' if there is no
+         *  Atoms section and no atoms
+         *
+         * Throws:
+         *  runtime_error if atoms are declared but have no section
+         */
+
+        // LAMMPS defaults for missing bounds
+        double lo[3] = {-0.5, -0.5, -0.5};
+        double hi[3] = {0.5, 0.5, 0.5};
+        double tilt[3] = {0, 0, 0};
+        const char *bounds[3] = {"xlo xhi", "ylo yhi", "zlo zhi"};
+
+        bool inSection = false;
+
+        auto setBox = [&]() {
+            data.box.lo = Tools::Vec3 {lo[0], lo[1], lo[2]};
+            data.box.len = Tools::Vec3 {hi[0]-lo[0], hi[1]-lo[1], hi[2]-lo[2]};
+            data.box.xy = tilt[0];
+            data.box.xz = tilt[1];
+            data.box.yz = tilt[2];
+        };
+
+        nAtoms = 0;
+        data.nTypes = 0;
+
+        // The first line is a title
+        for (p = nextLine(p, end); p < end; ) {
+            const char *line = p;
+            p = nextLine(p, end);
+
+            const char *stop = textEnd(line, p);
+            const char *q = skipBlanks(line, stop);
+
+            if (q == stop)
+                continue;
+
+            if (isalpha(static_cast<unsigned char>(*q))) {
+                inSection = true;
+
+                if (words(q, stop) != "Atoms")
+                    continue;
+
+                // Style from the comment, as in "Atoms # 'atomic'"
+                const char *hash = static_cast<const char*>(
+                        memchr(line, '#', p - line));
+                data.style = hash ? words(hash+1, textEnd(hash+1, p)) : "";
+                data.style.erase(remove(data.style.begin(), data.style.end(),
+                                        '\''), data.style.end());
+                data.style.erase(remove(data.style.begin(), data.style.end(),
+                                        '"'), data.style.end());
+
+                setBox();
+                return p;
+            }
+
+            if (inSection)
+                continue;
+
+            double value[3];
+            int n = 0;
+
+            while (n < 3 && readNumber(q, stop, value[n]))
+                n++;
+
+            string keyword = words(q, stop);
+
+            if (keyword == "atoms" && n == 1) {
+                nAtoms = static_cast<size_t>(value[0]);
+            } else if (keyword == "atom types" && n == 1) {
+                data.nTypes = static_cast<int>(value[0]);
+            } else if (keyword == "xy xz yz" && n == 3) {
+                copy(value, value+3, tilt);
+            } else {
+                for (int d=0; d<3; d++) {
+                    if (keyword == bounds[d] && n == 2) {
+                        lo[d] = value[0];
+                        hi[d] = value[1];
+                    }
+                }
+            }
+        }
+
+        if (nAtoms > 0)
+            throw runtime_error("data file has no Atoms section");
+
+        data.style = "";
+        setBox();
+        return end;
+    }
+}
+
 namespace Lammps {
 
-    void writeData(string filename, vector<dvec_t> arr) {
-        /* Writes an array of atom information to a LAMMPS style data file.
+    void formatAtoms(string &out, const AtomView &arr, size_t firstId,
+                        int precision, const double *extra, int extraDigits) {
+        /* Formats atoms as LAMMPS 'atomic' lines. The text is byte for byte
+         * what "%zu %d %f %f %f" (with 'precision' digits) gives, but
+         * without printf's locale and format string overhead.
+         *
+         * Args:
+         *  out         -   replaced by the text
+         *  arr         -   atoms to format
+         *  firstId     -   id of the first atom
+         *  precision   -   digits after the decimal point
+         *  extra       -   optional; one more value per atom, written
+         *                  after z as a comment, which LAMMPS skips
+         *  extraDigits -   digits after the decimal point of 'extra'
+         */
+
+        size_t bound = lineBound(precision) +
+                        (extra ? lineBound(extraDigits) : 0);
+        out.resize(arr.size()*bound);
+
+        size_t used = 0;
+
+        for (size_t i=0; i<arr.size(); i++) {
+            char *end = nullptr;
+
+            while (!end) {
+                end = formatLine(&out[0] + used, &out[0] + out.size(),
+                                    firstId+i, arr.type[i], arr.x[i],
+                                    arr.y[i], arr.z[i], precision);
+
+                // The extra value goes where the newline was
+                if (end && extra) {
+                    end = formatComment(end-1, &out[0] + out.size(),
+                                        extra[i], extraDigits);
+                }
+
+                // Only huge coordinates overrun the estimate
+                if (!end)
+                    out.resize(2*out.size() + bound);
+            }
+
+            used = end - &out[0];
+        }
+
+        out.resize(used);
+    }
+
+    void Writer::open(string filename, const Tools::Box &box, int digits,
+                        int nThreads, Compression compression) {
+        /* Creates the file and writes the header, with the counts left to
+         * close()
+         *
+         * Args:
+         *  filename    -   name of output file
+         *  box         -   simulation box, written as the LAMMPS bounds
+         *  digits      -   digits after the decimal point for coordinates
+         *  nThreads    -   threads used to format and compress large
+         *                  chunks
+         *  compression -   PLAIN, GZIP, or BY_NAME for gzip when the name
+         *                  ends in ".gz"
+         *
+         * Throws:
+         *  runtime_error if the file cannot be created
+         */
+
+        file = fopen(filename.c_str(), "w");
+
+        if (!file)
+            throw runtime_error("cannot open " + filename + " for writing");
+
+        nAtoms = 0;
+        nTypes = 0;
+        precision = digits;
+        threads = nThreads;
+        gzip = (compression == GZIP) ||
+                (compression == BY_NAME && endsWith(filename, ".gz"));
+        pending.clear();
+
+        header.clear();
+        if (comment) {
+            appendf(header, "# Data file written by Lammps::Writer; after "
+                    "each atom: %s\n", commentName.c_str());
+        } else {
+            appendf(header, "# Data file written by Lammps::Writer\n");
+        }
+        appendf(header, "\n");
+
+        countsPos = header.size();
+        header += counts(0, 0);
+
+        appendf(header, "\n");
+        int p = precision;
+
+        appendf(header, "%.*f %.*f xlo xhi\n", p, box.lo.x, p,
+                box.lo.x + box.len.x);
+        appendf(header, "%.*f %.*f ylo yhi\n", p, box.lo.y, p,
+                box.lo.y + box.len.y);
+        appendf(header, "%.*f %.*f zlo zhi\n", p, box.lo.z, p,
+                box.lo.z + box.len.z);
+
+        if (Tools::isTriclinic(box))
+            appendf(header, "%.*f %.*f %.*f xy xz yz\n", p, box.xy, p,
+                    box.xz, p, box.yz);
+
+        appendf(header, "\n");
+
+        // Atoms
+        appendf(header, "Atoms # 'atomic'\n");
+        appendf(header, "\n");
+
+        if (!writeHeader()) {
+            fclose(file);
+            file = nullptr;
+            throw runtime_error("failed to write header of " + filename);
+        }
+    }
+
+    void Writer::format(string &out, const AtomView &arr, size_t firstId,
+                        vector<double> &scratch) const {
+        /* Formats atoms the way write() does, with the comment values if
+         * set; thread-safe as long as 'comment' is
+         *
+         * Args:
+         *  out     -   replaced by the text
+         *  arr     -   atoms to format
+         *  firstId -   id of the first atom
+         *  scratch -   holds the comment values
+         */
+
+        if (!comment) {
+            formatAtoms(out, arr, firstId, precision);
+            return;
+        }
+
+        scratch.resize(arr.size());
+        comment(arr, scratch.data());
+
+        formatAtoms(out, arr, firstId, precision, scratch.data(),
+                    commentDigits);
+    }
+
+    bool Writer::writeHeader() {
+        /* Writes the header at the current position. Compressed, it is a
+         * gzip member of its own that only stores the text, so the member
+         * with the final counts has the same size and can replace it. */
+
+        string text;
+
+        if (gzip)
+            gzipMember(text, header.data(), header.size(), 0);
+        else
+            text = header;
+
+        return fwrite(text.data(), 1, text.size(), file) == text.size();
+    }
+
+    void Writer::pack(bool all) {
+        /* Compresses pending text in GZ_BLOCK pieces, one per task, and
+         * writes them. Text is held back until every thread has a piece,
+         * or all of it when 'all' is set.
+         *
+         * Throws:
+         *  runtime_error if compressing or writing fails
+         */
+
+        size_t whole = pending.size()/GZ_BLOCK;
+
+        if (!all && whole < static_cast<size_t>(max(threads, 1)))
+            return;
+
+        int nBlocks = static_cast<int>(all ?
+                (pending.size() + GZ_BLOCK - 1)/GZ_BLOCK : whole);
+
+        if (packed.size() < static_cast<size_t>(nBlocks))
+            packed.resize(nBlocks);
+
+        Parallel::forEach(nBlocks, threads, [&](int b, int) {
+            size_t first = b*GZ_BLOCK;
+
+            gzipMember(packed[b], pending.data() + first,
+                        min(GZ_BLOCK, pending.size() - first),
+                        Z_DEFAULT_COMPRESSION);
+        });
+
+        writeBlocks(file, packed, nBlocks, threads);
+
+        pending.erase(0, min(nBlocks*GZ_BLOCK, pending.size()));
+    }
+
+    void Writer::write(const AtomView &arr) {
+        /* Appends a chunk of atoms; ids continue from the previous chunk.
+         * Large chunks are split into blocks that are formatted in parallel;
+         * the length of each block's text then gives its offset in the file,
+         * and the blocks are written there in parallel too.
+         *
+         * Throws:
+         *  runtime_error if writing fails
+         */
+
+        for (size_t i=0; i<arr.size(); i++) {
+            if (arr.type[i] > nTypes)
+                nTypes = arr.type[i];
+        }
+
+        int nBlocks = static_cast<int>((arr.size() + BLOCK - 1)/BLOCK);
+
+        if (buffers.size() < static_cast<size_t>(nBlocks)) {
+            buffers.resize(nBlocks);
+            values.resize(nBlocks);
+        }
+
+        Parallel::forEach(nBlocks, threads, [&](int b, int) {
+            size_t first = b*BLOCK;
+            size_t count = min(BLOCK, arr.size() - first);
+
+            format(buffers[b], arr.slice(first, count), nAtoms+first+1,
+                    values[b]);
+        });
+
+        nAtoms += arr.size();
+
+        if (!gzip) {
+            writeBlocks(file, buffers, nBlocks, threads);
+            return;
+        }
+
+        for (int b=0; b<nBlocks; b++)
+            pending += buffers[b];
+
+        pack(false);
+    }
+
+    void Writer::append(const string &text, size_t count, int maxType) {
+        /* Appends atom lines formatted elsewhere, e.g. by formatAtoms with
+         * ids starting at nAtoms+1, so formatting can run off the thread
+         * doing the writing
+         *
+         * Args:
+         *  text    -   the lines of 'count' atoms
+         *  count   -   number of atoms in 'text'
+         *  maxType -   largest atom type in 'text'
+         *
+         * Throws:
+         *  runtime_error if writing fails
+         */
+
+        if (gzip) {
+            pending += text;
+            pack(false);
+        } else if (fwrite(text.data(), 1, text.size(), file) !=
+                    text.size()) {
+            throw runtime_error("failed to write atoms");
+        }
+
+        nAtoms += count;
+
+        if (maxType > nTypes)
+            nTypes = maxType;
+    }
+
+    void Writer::close() {
+        /* Writes what is still pending, fills in the atom and type counts
+         * and closes the file
+         *
+         * Throws:
+         *  runtime_error if the end of the file or the header cannot be
+         *  written
+         */
+
+        bool ok = true;
+
+        try {
+            if (gzip)
+                pack(true);
+        } catch (const runtime_error&) {
+            ok = false;
+        }
+
+        header.replace(countsPos, counts(0, 0).size(),
+                        counts(nAtoms, nTypes));
+
+        ok = ok && fflush(file) == 0 && fseeko(file, 0, SEEK_SET) == 0 &&
+                writeHeader();
+
+        ok = (fclose(file) == 0) && ok;
+        file = nullptr;
+
+        if (!ok)
+            throw runtime_error("failed to finish data file");
+    }
+
+    void writeData(string filename, const AtomView &arr,
+                    const Tools::Box &box, int precision, int threads,
+                    Compression compression) {
+        /* Writes a block of atoms to a LAMMPS style data file, with the
+         * simulation box as bounds. Default output atom style is 'atomic'.
+         *
+         * Args:
+         *  filename    -   name of output file
+         *  arr         -   view of the atoms to write
+         *  box         -   simulation box
+         *  precision   -   digits after the decimal point
+         *  threads     -   threads to format and write with
+         *  compression -   as for Writer::open
+         */
+
+        Writer writer;
+        writer.open(filename, box, precision, threads, compression);
+        writer.write(arr);
+        writer.close();
+    }
+
+    void writeData(string filename, const AtomView &arr) {
+        /* Writes a block of atoms to a LAMMPS style data file.
          * Default output atom style is 'atomic'.
          *
          * Args:
          *  filename    -   name of output file
-         *  arr         -   output array with format [type,x,y,z]
+         *  arr         -   view of the atoms to write
          */
 
         FILE * outfile;
@@ -36,33 +748,29 @@ namespace Lammps {
         double ylo=0, yhi=0;
         double zlo=0, zhi=0;
 
-        dvec_t temp;
-
         nAtoms = static_cast<int>(arr.size());
 
-        for (vector<dvec_t>::size_type i=0; i<arr.size(); i++) {
-            temp = arr[i];
+        for (size_t i=0; i<arr.size(); i++) {
+            if (arr.type[i]>nTypes)
+                nTypes = arr.type[i];
 
-            if (temp[0]>nTypes)
-                nTypes = temp[0];
+            if (arr.x[i]<xlo)
+                xlo = arr.x[i];
 
-            if (temp[1]<xlo)
-                xlo = temp[1];
+            if (arr.x[i]>xhi)
+                xhi = arr.x[i];
 
-            if (temp[1]>xhi)
-                xhi = temp[1];
+            if (arr.y[i]<ylo)
+                ylo = arr.y[i];
 
-            if (temp[2]<ylo)
-                ylo = temp[2];
+            if (arr.y[i]>yhi)
+                yhi = arr.y[i];
 
-            if (temp[2]>yhi)
-                yhi = temp[2];
+            if (arr.z[i]<zlo)
+                zlo = arr.z[i];
 
-            if (temp[3]<zlo)
-                zlo = temp[3];
-
-            if (temp[3]>zhi)
-                zhi = temp[3];
+            if (arr.z[i]>zhi)
+                zhi = arr.z[i];
         }
 
         fprintf(outfile, "%d atoms\n", nAtoms);
@@ -77,15 +785,170 @@ namespace Lammps {
         fprintf(outfile, "Atoms # 'atomic'\n");
         fprintf(outfile, "\n");
 
-        for (vector<dvec_t>::size_type i=0; i<arr.size(); i++) {
-            temp = arr[i];
+        for (size_t i=0; i<arr.size(); i++) {
             fprintf(outfile, "%d %d %f %f %f\n", static_cast<int>(i)+1,
-                    static_cast<int>(temp[0]), temp[1], temp[2], temp[3]);
+                    arr.type[i], arr.x[i], arr.y[i], arr.z[i]);
+        }
+
+        fclose(outfile);
+    }
+
+    void writeData(string filename, vector<dvec_t> arr) {
+        /* Writes an array of atom information to a LAMMPS style data file.
+         * Default output atom style is 'atomic'.
+         *
+         * Args:
+         *  filename    -   name of output file
+         *  arr         -   output array with format [type,x,y,z]
+         */
+
+        Atoms atoms = Atoms::fromArray(arr);
+        writeData(filename, atoms.view());
+    }
+
+    void readData(string filename, Data &data, int threads) {
+        /* Reads a LAMMPS data file in the 'atomic' or 'charge' style. The
+         * file is memory mapped and cut into ranges of whole lines; one
+         * pass counts the atom lines of every range, which gives each
+         * range its first atom, and a second pass parses the ranges in
+         * parallel straight into the columns. Image flags are ignored.
+         *
+         * Args:
+         *  filename    -   name of input file
+         *  data        -   replaced by the contents of the file
+         *  threads     -   threads to parse with
+         *
+         * Throws:
+         *  runtime_error if the file cannot be read, has another atom
+         *  style, or its atom count or lines are wrong
+         */
+
+        Mapped file(filename);
+        const char *end = file.data + file.size;
+
+        size_t nAtoms = 0;
+        const char *body = readHeader(file.data, end, data, nAtoms);
+
+        // Several ranges per thread, so uneven ranges still balance
+        int nRanges = max(1, min(4*threads,
+                static_cast<int>((end - body)/(1 << 16)) + 1));
+
+        vector<const char*> cut(nRanges+1);
+        cut[0] = body;
+        cut[nRanges] = end;
+
+        for (int r=1; r<nRanges; r++) {
+            const char *at = body + (end - body)*r/nRanges;
+            cut[r] = (at[-1] == '\n') ? at : nextLine(at, end);
+        }
+
+        // Lines of each range up to the section after Atoms, if any
+        vector<size_t> lines(nRanges, 0);
+        vector<const char*> stop(cut.begin()+1, cut.end());
+
+        Parallel::forEach(nRanges, threads, [&](int r, int) {
+            for (const char *p=cut[r]; p<stop[r]; ) {
+                const char *line = p;
+                p = nextLine(p, stop[r]);
+
+                const char *q = skipBlanks(line, p);
+
+                if (q == p || *q == '\n' || *q == '#')
+                    continue;
+
+                if (isalpha(static_cast<unsigned char>(*q))) {
+                    stop[r] = line;
+                    break;
+                }
+
+                lines[r]++;
+            }
+        });
+
+        vector<size_t> first(nRanges, 0);
+        size_t found = 0;
+        int used = 0;
+
+        for (int r=0; r<nRanges; r++) {
+            first[r] = found;
+            found += lines[r];
+            used = r+1;
+
+            if (stop[r] != cut[r+1])
+                break;
+        }
+
+        if (found != nAtoms) {
+            throw runtime_error(filename + " declares " + to_string(nAtoms) +
+                                " atoms but lists " + to_string(found));
+        }
+
+        // Without a style comment the columns of the first atom tell the
+        // style, with or without image flags
+        int columns = 0;
+
+        for (const char *p=body; nAtoms > 0 && p<end; p=nextLine(p, end)) {
+            const char *q = skipBlanks(p, end);
+
+            if (q < end && (isdigit(static_cast<unsigned char>(*q)) ||
+                            *q == '-' || *q == '+')) {
+                string sample = words(q, textEnd(q, nextLine(q, end)));
+                columns = count(sample.begin(), sample.end(), ' ') + 1;
+                break;
+            }
         }
+
+        if (data.style.empty())
+            data.style = (columns == 6 || columns == 9) ? "charge" : "atomic";
+
+        if (data.style != "atomic" && data.style != "charge")
+            throw runtime_error("unsupported atom style " + data.style);
+
+        bool charged = (data.style == "charge");
+
+        data.atoms.clear();
+        data.atoms.resize(nAtoms);
+        data.id.resize(nAtoms);
+        data.charge.assign(charged ? nAtoms : 0, 0.0);
+
+        Parallel::forEach(used, threads, [&](int r, int) {
+            size_t i = first[r];
+
+            for (const char *p=cut[r]; p<stop[r]; ) {
+                const char *line = p;
+                p = nextLine(p, stop[r]);
+
+                const char *q = skipBlanks(line, p);
+
+                if (q == p || *q == '\n' || *q == '#')
+                    continue;
+
+                bool ok = readNumber(q, p, data.id[i]) &&
+                            readNumber(q, p, data.atoms.type[i]);
+
+                if (charged)
+                    ok = ok && readNumber(q, p, data.charge[i]);
+
+                ok = ok && readNumber(q, p, data.atoms.x[i]) &&
+                        readNumber(q, p, data.atoms.y[i]) &&
+                        readNumber(q, p, data.atoms.z[i]);
+
+                if (!ok) {
+                    throw runtime_error("bad atom line in " + filename +
+                                        ": " + string(line, p - line));
+                }
+
+                i++;
+            }
+        });
     }
 
     vector<dvec_t> readData(string filename) {
-        vector<dvec_t> temp;
-        return temp;
+        /* Reads a data file into the [type,x,y,z] row format */
+
+        Data data;
+        readData(filename, data);
+
+        return data.atoms.toArray();
     }
 }
@@ -3,12 +3,96 @@
 
 #include <vector>
 #include <string>
+#include <cstdio>
+#include <functional>
 #include "define.h"
+#include "Atoms.h"
+#include "Tools.h"
 
 namespace Lammps {
 
+    // Output encoding; BY_NAME picks GZIP for names ending in ".gz"
+    enum Compression {PLAIN, GZIP, BY_NAME};
+
+    /* Writes a data file atom chunk by atom chunk, so the whole system never
+     * has to be in memory at once. The header is written first with fixed
+     * width placeholders for the counts, which close() overwrites in place
+     * once they are known. Box bounds come from the simulation box, not
+     * from the atoms.
+     *
+     * Compressed output is a series of gzip members, each compressed on its
+     * own thread from about a megabyte of text, which gzip and LAMMPS read
+     * as one stream.
+     */
+    struct Writer {
+        FILE *file;
+        bool gzip;
+        std::string header;
+        size_t countsPos;           // offset of the counts in the header
+        size_t nAtoms;
+        int nTypes;
+        int precision;              // digits after the decimal point
+        int threads;                // threads formatting large chunks
+
+        // Text of each block of a chunk; kept to reuse their storage
+        std::vector<std::string> buffers;
+
+        // Text waiting to be compressed, and compressed blocks
+        std::string pending;
+        std::vector<std::string> packed;
+
+        // Optional per-atom value, written as a comment ("# value") after
+        // each atom so LAMMPS still reads the line: fills one value per
+        // atom of a view. Set it, its name for the header and its digits
+        // before open().
+        std::function<void(const AtomView&, double*)> comment;
+        std::string commentName;
+        int commentDigits;
+
+        // Comment values of each block
+        std::vector<std::vector<double> > values;
+
+        void open(std::string, const Tools::Box&, int precision=6,
+                    int threads=1, Compression compression=BY_NAME);
+
+        void write(const AtomView&);
+
+        void append(const std::string&, size_t, int);
+
+        void format(std::string&, const AtomView&, size_t,
+                    std::vector<double>&) const;
+
+        void close();
+
+        bool writeHeader();
+
+        void pack(bool);
+    };
+
+    // Contents of a data file. Atoms keep the order of the file and have
+    // grain -1; their ids are kept alongside.
+    struct Data {
+        Tools::Box box;
+        int nTypes;
+        std::string style;          // "atomic" or "charge"
+        Atoms atoms;
+        std::vector<size_t> id;
+        std::vector<double> charge; // empty unless the style is "charge"
+    };
+
     void writeData(std::string, vector<dvec_t>);
 
+    void writeData(std::string, const AtomView&);
+
+    void writeData(std::string, const AtomView&, const Tools::Box&,
+                    int precision=6, int threads=1,
+                    Compression compression=BY_NAME);
+
+    void formatAtoms(std::string&, const AtomView&, size_t, int,
+                        const double *extra=nullptr, int extraDigits=0);
+
+    void readData(std::string, Data&, int threads=1);
+
     vector<dvec_t> readData(std::string);
 }
 
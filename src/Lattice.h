@@ -0,0 +1,100 @@
+#ifndef LATTICE_H
+#define LATTICE_H
+
+#include "Tools.h"
+
+using namespace std;
+
+/* Compile-time lattice definitions. Each lattice is a type holding its
+ * conventional cell and basis as constexpr tables, so a generator templated
+ * on it knows the number of sites at compile time and can emit every
+ * sublattice in one unrolled pass.
+ *
+ * Sites are fractional coordinates of the conventional cell; 'sub' is the
+ * sublattice index, which picks the atom type from the types passed to the
+ * generator. 'cell' is the edge lengths of the cell in units of the lattice
+ * constant.
+ */
+namespace Lattice {
+
+    struct Site {
+        double x;
+        double y;
+        double z;
+        int sub;
+    };
+
+    struct FCC {
+        static constexpr int nSub = 1;
+        static constexpr int nSites = 4;
+        static constexpr Tools::Vec3 cell = {1, 1, 1};
+        static constexpr Site sites[nSites] = {
+            {0, 0, 0, 0}, {0.5, 0.5, 0, 0}, {0, 0.5, 0.5, 0}, {0.5, 0, 0.5, 0}
+        };
+    };
+
+    struct BCC {
+        static constexpr int nSub = 1;
+        static constexpr int nSites = 2;
+        static constexpr Tools::Vec3 cell = {1, 1, 1};
+        static constexpr Site sites[nSites] = {
+            {0, 0, 0, 0}, {0.5, 0.5, 0.5, 0}
+        };
+    };
+
+    // Orthohexagonal cell (a, sqrt(3)a, c) with the ideal c/a = sqrt(8/3)
+    struct HCP {
+        static constexpr int nSub = 1;
+        static constexpr int nSites = 4;
+        static constexpr Tools::Vec3 cell = {1, 1.7320508075688772,
+                                                1.6329931618554521};
+        static constexpr Site sites[nSites] = {
+            {0, 0, 0, 0}, {0.5, 0.5, 0, 0},
+            {0.5, 5.0/6, 0.5, 0}, {0, 1.0/3, 0.5, 0}
+        };
+    };
+
+    struct Diamond {
+        static constexpr int nSub = 1;
+        static constexpr int nSites = 8;
+        static constexpr Tools::Vec3 cell = {1, 1, 1};
+        static constexpr Site sites[nSites] = {
+            {0, 0, 0, 0}, {0.5, 0.5, 0, 0}, {0, 0.5, 0.5, 0}, {0.5, 0, 0.5, 0},
+            {0.25, 0.25, 0.25, 0}, {0.75, 0.75, 0.25, 0},
+            {0.25, 0.75, 0.75, 0}, {0.75, 0.25, 0.75, 0}
+        };
+    };
+
+    // Rocksalt (NaCl)
+    struct B1 {
+        static constexpr int nSub = 2;
+        static constexpr int nSites = 8;
+        static constexpr Tools::Vec3 cell = {1, 1, 1};
+        static constexpr Site sites[nSites] = {
+            {0, 0, 0, 0}, {0.5, 0.5, 0, 0}, {0, 0.5, 0.5, 0}, {0.5, 0, 0.5, 0},
+            {0.5, 0.5, 0.5, 1}, {0, 0, 0.5, 1}, {0, 0.5, 0, 1}, {0.5, 0, 0, 1}
+        };
+    };
+
+    // Cesium chloride
+    struct B2 {
+        static constexpr int nSub = 2;
+        static constexpr int nSites = 2;
+        static constexpr Tools::Vec3 cell = {1, 1, 1};
+        static constexpr Site sites[nSites] = {
+            {0, 0, 0, 0}, {0.5, 0.5, 0.5, 1}
+        };
+    };
+
+    // A3B (Cu3Au); sublattice 0 is the face centers, 1 the corners
+    struct L12 {
+        static constexpr int nSub = 2;
+        static constexpr int nSites = 4;
+        static constexpr Tools::Vec3 cell = {1, 1, 1};
+        static constexpr Site sites[nSites] = {
+            {0.5, 0.5, 0, 0}, {0, 0.5, 0.5, 0}, {0.5, 0, 0.5, 0}, {0, 0, 0, 1}
+        };
+    };
+}
+
+#endif
@@ -0,0 +1,73 @@
+/* Allocation counting and peak memory reporting.
+ *
+ * Author: Josh Vita
+ * Created: 2017/7
+ * Last edited: 2017/7
+ */
+
+#include <cstdlib>
+#include <cstddef>
+#include <atomic>
+#include <new>
+#include <sys/resource.h>
+#include "Memory.h"
+
+using namespace std;
+
+namespace {
+
+    atomic<size_t> allocations(0);
+    atomic<size_t> bytes(0);
+
+    void *allocate(size_t size) {
+        allocations.fetch_add(1, memory_order_relaxed);
+        bytes.fetch_add(size, memory_order_relaxed);
+
+        void *p = malloc(size ? size : 1);
+
+        if (!p)
+            throw bad_alloc();
+
+        return p;
+    }
+}
+
+void *operator new(size_t size) {
+    return allocate(size);
+}
+
+void *operator new[](size_t size) {
+    return allocate(size);
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    free(p);
+}
+
+namespace Memory {
+
+    Usage usage() {
+        /* Allocation counts so far and the peak resident set size */
+
+        Usage u;
+        u.allocations = allocations.load(memory_order_relaxed);
+        u.bytes = bytes.load(memory_order_relaxed);
+
+        struct rusage r;
+        u.peakRss = (getrusage(RUSAGE_SELF, &r) == 0) ? r.ru_maxrss : 0;
+
+        return u;
+    }
+}
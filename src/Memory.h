@@ -0,0 +1,24 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <cstddef>
+
+using namespace std;
+
+/* Process memory accounting. Linking Memory.o replaces the global operator
+ * new/delete with counting versions that forward to malloc/free, so every
+ * heap allocation made through new (including all standard containers) is
+ * counted.
+ */
+namespace Memory {
+
+    struct Usage {
+        size_t allocations;         // calls to operator new so far
+        size_t bytes;               // bytes requested from operator new
+        long peakRss;               // peak resident set size in kB
+    };
+
+    Usage usage();
+}
+
+#endif
@@ -0,0 +1,284 @@
+/* Space-filling curve keys and a parallel radix sort by them.
+ *
+ * Author: Josh Vita
+ * Created: 2017/7
+ * Last edited: 2017/7
+ */
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+#include "Atoms.h"
+#include "Tools.h"
+#include "Parallel.h"
+#include "Order.h"
+
+using namespace std;
+
+namespace {
+
+    // Bits sorted per radix pass; 11 covers a 63-bit key in 6 passes with
+    // counts that stay in L1
+    const int RADIX_BITS = 11;
+    const int RADIX = 1 << RADIX_BITS;
+
+    uint64_t spread(uint64_t v) {
+        /* Moves bit i of a 21-bit value to bit 3i */
+
+        v &= 0x1fffff;
+        v = (v | v << 32) & 0x1f00000000ffffull;
+        v = (v | v << 16) & 0x1f0000ff0000ffull;
+        v = (v | v << 8) & 0x100f00f00f00f00full;
+        v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+        v = (v | v << 2) & 0x1249249249249249ull;
+
+        return v;
+    }
+
+    uint32_t quantize(double f, int bits) {
+        /* Fractional coordinate in [0,1) to 'bits' bits */
+
+        const double scale = static_cast<double>(1u << bits);
+
+        // Atoms are nearly always inside the box already
+        if (f < 0 || f >= 1)
+            f -= floor(f);
+
+        return min(static_cast<uint32_t>(f*scale), (1u << bits) - 1);
+    }
+
+    // Contiguous share s of n items when split 'parts' ways
+    size_t share(size_t n, int s, int parts) {
+        return n*s/parts;
+    }
+
+    template<class T>
+    void gather(vector<T> &column, const vector<uint32_t> &order,
+                int threads) {
+        /* Puts column[order[i]] at i */
+
+        vector<T> sorted(column.size());
+
+        Parallel::forEach(threads, threads, [&](int s, int) {
+            size_t end = share(column.size(), s+1, threads);
+
+            for (size_t i=share(column.size(), s, threads); i<end; i++)
+                sorted[i] = column[order[i]];
+        });
+
+        column.swap(sorted);
+    }
+}
+
+namespace Order {
+
+    uint64_t morton(uint32_t x, uint32_t y, uint32_t z) {
+        /* Interleaves the low BITS bits of x, y and z, x lowest */
+
+        return spread(x) | spread(y) << 1 | spread(z) << 2;
+    }
+
+    uint64_t hilbert(uint32_t x, uint32_t y, uint32_t z, int bits) {
+        /* Index along the 3-D Hilbert curve through the 2^bits grid, from
+         * Skilling's transpose algorithm (AIP Conf. Proc. 707, 381 (2004)).
+         * Consecutive indices are grid neighbors.
+         */
+
+        uint32_t X[3] = {x, y, z};
+        const uint32_t M = 1u << (bits-1);
+
+        // Inverse undo of the excess work. Without branches: the bits of
+        // random atoms make them unpredictable.
+        for (uint32_t Q=M; Q>1; Q>>=1) {
+            uint32_t P = Q-1;
+
+            for (int i=0; i<3; i++) {
+                // All ones where X[i] has bit Q: invert the low bits of
+                // X[0]; otherwise exchange them with those of X[i]
+                uint32_t set = 0u - ((X[i] & Q) != 0);
+                uint32_t t = (X[0] ^ X[i]) & P & ~set;
+
+                X[0] ^= (P & set) | t;
+                X[i] ^= t;
+            }
+        }
+
+        // Gray encode
+        X[1] ^= X[0];
+        X[2] ^= X[1];
+
+        uint32_t t = 0;
+
+        for (uint32_t Q=M; Q>1; Q>>=1) {
+            if (X[2] & Q)
+                t ^= Q-1;
+        }
+
+        for (int i=0; i<3; i++)
+            X[i] ^= t;
+
+        // The transposed index has X[0] as the top bit of every triple
+        return morton(X[2], X[1], X[0]);
+    }
+
+    void keys(const AtomView &atoms, const Tools::Box &box, Curve curve,
+                uint64_t *out, int bits, int threads) {
+        /* Curve keys of atoms from their fractional coordinates in the
+         * box; atoms outside it get the key of their periodic image.
+         *
+         * Args:
+         *  atoms   -   atoms to key
+         *  box     -   simulation box
+         *  curve   -   MORTON or HILBERT
+         *  out     -   receives one key per atom
+         *  bits    -   bits per axis, at most BITS
+         *  threads -   threads to use
+         */
+
+        Parallel::forEach(threads, threads, [&](int s, int) {
+            size_t end = share(atoms.size(), s+1, threads);
+
+            for (size_t i=share(atoms.size(), s, threads); i<end; i++) {
+                double dz = atoms.z[i] - box.lo.z;
+                double dy = atoms.y[i] - box.lo.y;
+                double dx = atoms.x[i] - box.lo.x;
+
+                double fc = dz/box.len.z;
+                double fb = (dy - fc*box.yz)/box.len.y;
+                double fa = (dx - fb*box.xy - fc*box.xz)/box.len.x;
+
+                uint32_t qa = quantize(fa, bits);
+                uint32_t qb = quantize(fb, bits);
+                uint32_t qc = quantize(fc, bits);
+
+                out[i] = (curve == HILBERT) ? hilbert(qa, qb, qc, bits) :
+                                                morton(qa, qb, qc);
+            }
+        });
+    }
+
+    void radixSort(vector<uint64_t> &key, vector<uint32_t> &order,
+                    int threads) {
+        /* Stable least-significant-digit radix sort of 'key', carrying
+         * 'order' along. Every pass splits the keys into one contiguous
+         * share per thread: each share is counted, the counts of all
+         * shares give every (digit, share) pair its place, and the shares
+         * are scattered in parallel. Passes whose digit is the same for
+         * every key are skipped.
+         *
+         * Args:
+         *  key     -   sorted in place
+         *  order   -   permuted like 'key'
+         *  threads -   threads to use
+         */
+
+        size_t n = key.size();
+
+        if (n == 0)
+            return;
+
+        // Small sorts are not worth the extra counting
+        if (n < static_cast<size_t>(threads)*RADIX)
+            threads = 1;
+
+        vector<uint64_t> key2(n);
+        vector<uint32_t> order2(n);
+        vector<size_t> count(static_cast<size_t>(threads)*RADIX);
+
+        for (int shift=0; shift<64; shift+=RADIX_BITS) {
+            fill(count.begin(), count.end(), 0);
+
+            Parallel::forEach(threads, threads, [&](int s, int) {
+                size_t *c = &count[static_cast<size_t>(s)*RADIX];
+                size_t end = share(n, s+1, threads);
+
+                for (size_t i=share(n, s, threads); i<end; i++)
+                    c[(key[i] >> shift) & (RADIX-1)]++;
+            });
+
+            // Every key has the same digit: nothing moves
+            bool same = false;
+
+            for (int d=0; d<RADIX && !same; d++) {
+                size_t total = 0;
+
+                for (int s=0; s<threads; s++)
+                    total += count[static_cast<size_t>(s)*RADIX + d];
+
+                same = (total == n);
+            }
+
+            if (same)
+                continue;
+
+            size_t place = 0;
+
+            for (int d=0; d<RADIX; d++) {
+                for (int s=0; s<threads; s++) {
+                    size_t c = count[static_cast<size_t>(s)*RADIX + d];
+                    count[static_cast<size_t>(s)*RADIX + d] = place;
+                    place += c;
+                }
+            }
+
+            Parallel::forEach(threads, threads, [&](int s, int) {
+                size_t *at = &count[static_cast<size_t>(s)*RADIX];
+                size_t end = share(n, s+1, threads);
+
+                for (size_t i=share(n, s, threads); i<end; i++) {
+                    size_t j = at[(key[i] >> shift) & (RADIX-1)]++;
+                    key2[j] = key[i];
+                    order2[j] = order[i];
+                }
+            });
+
+            key.swap(key2);
+            order.swap(order2);
+        }
+    }
+
+    void sort(Atoms &atoms, const Tools::Box &box, Curve curve,
+                int threads) {
+        /* Reorders atoms along a space-filling curve over the box. The grid
+         * the curve runs through has about eight cells per atom, finer
+         * being no use for locality; atoms sharing a cell keep their order,
+         * so the result does not depend on the number of threads.
+         *
+         * Args:
+         *  atoms   -   sorted in place
+         *  box     -   simulation box
+         *  curve   -   MORTON or HILBERT; NONE leaves the atoms alone
+         *  threads -   threads to use
+         *
+         * Throws:
+         *  length_error for 2^32 atoms or more
+         */
+
+        if (curve == NONE || atoms.empty())
+            return;
+
+        if (atoms.size() >= (static_cast<size_t>(1) << 32))
+            throw length_error("too many atoms to sort");
+
+        vector<uint64_t> key(atoms.size());
+        vector<uint32_t> order(atoms.size());
+
+        for (size_t i=0; i<order.size(); i++)
+            order[i] = static_cast<uint32_t>(i);
+
+        int bits = static_cast<int>(ceil(log2(cbrt(
+                        static_cast<double>(atoms.size()))))) + 1;
+        bits = min(max(bits, 1), BITS);
+
+        keys(atoms.view(), box, curve, key.data(), bits, threads);
+        radixSort(key, order, threads);
+
+        gather(atoms.x, order, threads);
+        gather(atoms.y, order, threads);
+        gather(atoms.z, order, threads);
+        gather(atoms.type, order, threads);
+        gather(atoms.grain, order, threads);
+    }
+}
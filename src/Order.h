@@ -0,0 +1,35 @@
+#ifndef ORDER_H
+#define ORDER_H
+
+#include <vector>
+#include <cstdint>
+#include "Atoms.h"
+#include "Tools.h"
+
+using namespace std;
+
+/* Space-filling curve orderings of atoms. Sorting by the curve key puts
+ * atoms that are close in space close in memory and in the output file,
+ * which neighbor list builds and post-processing rely on for locality.
+ */
+namespace Order {
+
+    enum Curve {NONE, MORTON, HILBERT};
+
+    // Bits per axis of the quantized fractional coordinates; three of
+    // them fill a 63-bit key
+    const int BITS = 21;
+
+    uint64_t morton(uint32_t, uint32_t, uint32_t);
+
+    uint64_t hilbert(uint32_t, uint32_t, uint32_t, int bits=BITS);
+
+    void keys(const AtomView&, const Tools::Box&, Curve, uint64_t*,
+                int bits=BITS, int threads=1);
+
+    void radixSort(vector<uint64_t>&, vector<uint32_t>&, int threads=1);
+
+    void sort(Atoms&, const Tools::Box&, Curve, int threads=1);
+}
+
+#endif
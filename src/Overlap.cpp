@@ -0,0 +1,340 @@
+/* Finds atoms closer than a cutoff with a periodic cell list and removes
+ * one atom of every close pair.
+ *
+ * Author: Josh Vita
+ * Created: 2017/7
+ * Last edited: 2017/7
+ */
+
+#include <vector>
+#include <map>
+#include <utility>
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+#include "Atoms.h"
+#include "Tools.h"
+#include "Parallel.h"
+#include "Overlap.h"
+
+using namespace std;
+
+namespace {
+
+    enum State {UNDECIDED, KEPT, REMOVED};
+
+    // Cells handed to a thread at a time during the pair search
+    const int CELL_BATCH = 64;
+
+    /* Periodic cell list over fractional coordinates. Cells are at least
+     * the cutoff wide perpendicular to every face, so all partners of an
+     * atom are in its own cell or the 26 around it.
+     */
+    struct CellList {
+        int n[3];
+        vector<int> start;          // CSR: atoms of cell c are
+        vector<size_t> atoms;       // atoms[start[c]..start[c+1])
+
+        int index(int a, int b, int c) const {
+            return (c*n[1] + b)*n[0] + a;
+        }
+    };
+
+    void fractional(const Tools::Box &box, double x, double y, double z,
+                    double f[3]) {
+        double fc = (z - box.lo.z)/box.len.z;
+        double fb = (y - box.lo.y - fc*box.yz)/box.len.y;
+        double fa = (x - box.lo.x - fb*box.xy - fc*box.xz)/box.len.x;
+
+        f[0] = fa - floor(fa);
+        f[1] = fb - floor(fb);
+        f[2] = fc - floor(fc);
+    }
+
+    void buildCells(CellList &cells, const AtomView &atoms,
+                    const Tools::Box &box, double cutoff, int threads) {
+        /* Bins atoms by cell, keeping atom order within each cell
+         *
+         * Throws:
+         *  invalid_argument if the cutoff is not below half the box
+         *  height along some axis
+         */
+
+        Tools::Vec3 a = {box.len.x, 0, 0};
+        Tools::Vec3 b = {box.xy, box.len.y, 0};
+        Tools::Vec3 c = {box.xz, box.yz, box.len.z};
+
+        double volume = box.len.x*box.len.y*box.len.z;
+        double height[3] = {volume/sqrt(Tools::norm2(Tools::cross(b, c))),
+                            volume/sqrt(Tools::norm2(Tools::cross(c, a))),
+                            volume/sqrt(Tools::norm2(Tools::cross(a, b)))};
+
+        for (int d=0; d<3; d++) {
+            if (!(cutoff > 0) || 2*cutoff >= height[d])
+                throw invalid_argument("overlap cutoff must be positive and "
+                                        "below half the box");
+
+        }
+
+        // No more cells than about two per atom; larger cells still hold
+        // every partner within reach
+        double most = 2.0*atoms.size() + 1;
+        double shrink = max(1.0, cbrt(height[0]/cutoff*height[1]/cutoff*
+                                        height[2]/cutoff/most));
+
+        for (int d=0; d<3; d++)
+            cells.n[d] = max(1, static_cast<int>(height[d]/cutoff/shrink));
+
+        int nCells = cells.n[0]*cells.n[1]*cells.n[2];
+        vector<int> cell(atoms.size());
+
+        Parallel::forEach(threads, threads, [&](int s, int) {
+            size_t end = atoms.size()*(s+1)/threads;
+
+            for (size_t i=atoms.size()*s/threads; i<end; i++) {
+                double f[3];
+                fractional(box, atoms.x[i], atoms.y[i], atoms.z[i], f);
+
+                int k[3];
+
+                for (int d=0; d<3; d++)
+                    k[d] = min(static_cast<int>(f[d]*cells.n[d]),
+                                cells.n[d]-1);
+
+                cell[i] = cells.index(k[0], k[1], k[2]);
+            }
+        });
+
+        cells.start.assign(nCells+1, 0);
+
+        for (size_t i=0; i<atoms.size(); i++)
+            cells.start[cell[i]+1]++;
+
+        for (int k=0; k<nCells; k++)
+            cells.start[k+1] += cells.start[k];
+
+        vector<int> fill(cells.start.begin(), cells.start.end()-1);
+        cells.atoms.resize(atoms.size());
+
+        for (size_t i=0; i<atoms.size(); i++)
+            cells.atoms[fill[cell[i]]++] = i;
+    }
+
+    void neighborCells(const CellList &cells, int k, vector<int> &out) {
+        /* The distinct cells around cell k, itself included */
+
+        int a = k % cells.n[0];
+        int b = (k / cells.n[0]) % cells.n[1];
+        int c = k / (cells.n[0]*cells.n[1]);
+
+        out.clear();
+
+        for (int dc=-1; dc<=1; dc++)
+        for (int db=-1; db<=1; db++)
+        for (int da=-1; da<=1; da++) {
+            int m = cells.index((a+da+cells.n[0]) % cells.n[0],
+                                (b+db+cells.n[1]) % cells.n[1],
+                                (c+dc+cells.n[2]) % cells.n[2]);
+
+            // Thin boxes wrap onto the same cell more than once
+            if (find(out.begin(), out.end(), m) == out.end())
+                out.push_back(m);
+        }
+    }
+
+    bool outranks(const AtomView &atoms, Overlap::Policy policy, size_t j,
+                    size_t i) {
+        /* Whether atom j survives a close pair with atom i */
+
+        if (policy != Overlap::FIRST && atoms.grain[j] != atoms.grain[i]) {
+            return (policy == Overlap::LOWER_GRAIN) ?
+                    atoms.grain[j] < atoms.grain[i] :
+                    atoms.grain[j] > atoms.grain[i];
+        }
+
+        return j < i;
+    }
+}
+
+namespace Overlap {
+
+    Report removeClose(Atoms &atoms, const Tools::Box &box, double cutoff,
+                        Policy policy, int threads) {
+        /* Removes atoms so that no two remaining atoms are closer than
+         * 'cutoff'. The policy ranks the atoms of every close pair; the
+         * result is what removing atoms one by one, best ranked first,
+         * would give: an atom stays unless an atom that outranks it and is
+         * close to it stays. It is found in parallel rounds, each deciding
+         * the atoms whose better ranked partners are all decided, and does
+         * not depend on the number of threads.
+         *
+         * Args:
+         *  atoms   -   atoms to thin out; the rest keep their order
+         *  box     -   periodic simulation box
+         *  cutoff  -   closest distance allowed
+         *  policy  -   which atom of a close pair survives
+         *  threads -   threads to use
+         *
+         * Returns:
+         *  report  -   close pairs and removed atoms, in total and per
+         *              grain pair
+         *
+         * Throws:
+         *  invalid_argument if the cutoff is not below half the box
+         */
+
+        Report report;
+        report.pairs = 0;
+        report.removed = 0;
+
+        if (atoms.empty())
+            return report;
+
+        AtomView view = atoms.view();
+        CellList cells;
+        buildCells(cells, view, box, cutoff, threads);
+
+        // Close pairs as (atom, partner that outranks it), each found once
+        int nCells = cells.n[0]*cells.n[1]*cells.n[2];
+        int nBatches = (nCells + CELL_BATCH - 1)/CELL_BATCH;
+        vector<vector<pair<size_t, size_t> > > found(nBatches);
+        double cut2 = cutoff*cutoff;
+
+        Parallel::forEach(nBatches, threads, [&](int batch, int) {
+            vector<int> around;
+            int last = min(nCells, (batch+1)*CELL_BATCH);
+
+            for (int k=batch*CELL_BATCH; k<last; k++) {
+                neighborCells(cells, k, around);
+
+                for (int p=cells.start[k]; p<cells.start[k+1]; p++) {
+                    size_t i = cells.atoms[p];
+
+                    for (size_t m=0; m<around.size(); m++) {
+                        for (int q=cells.start[around[m]];
+                                q<cells.start[around[m]+1]; q++) {
+                            size_t j = cells.atoms[q];
+
+                            if (j == i || !outranks(view, policy, j, i))
+                                continue;
+
+                            Tools::Vec3 d = {view.x[i]-view.x[j],
+                                                view.y[i]-view.y[j],
+                                                view.z[i]-view.z[j]};
+
+                            if (Tools::norm2(Tools::minImage(d, box)) < cut2)
+                                found[batch].push_back(make_pair(i, j));
+                        }
+                    }
+                }
+            }
+        });
+
+        vector<pair<size_t, size_t> > pairs;
+
+        for (int b=0; b<nBatches; b++)
+            pairs.insert(pairs.end(), found[b].begin(), found[b].end());
+
+        sort(pairs.begin(), pairs.end());
+        report.pairs = pairs.size();
+
+        // Atoms outranked by some partner, with their partners in CSR form
+        vector<size_t> outranked;
+        vector<size_t> first;
+
+        for (size_t p=0; p<pairs.size(); p++) {
+            if (p == 0 || pairs[p].first != pairs[p-1].first) {
+                outranked.push_back(pairs[p].first);
+                first.push_back(p);
+            }
+        }
+
+        first.push_back(pairs.size());
+
+        vector<char> state(atoms.size(), KEPT);
+
+        for (size_t o=0; o<outranked.size(); o++)
+            state[outranked[o]] = UNDECIDED;
+
+        vector<char> next(state);
+        bool undecided = !outranked.empty();
+
+        while (undecided) {
+            Parallel::forEach(threads, threads, [&](int s, int) {
+                size_t end = outranked.size()*(s+1)/threads;
+
+                for (size_t o=outranked.size()*s/threads; o<end; o++) {
+                    size_t i = outranked[o];
+
+                    if (state[i] != UNDECIDED)
+                        continue;
+
+                    bool waiting = false;
+                    char decided = KEPT;
+
+                    for (size_t p=first[o]; p<first[o+1]; p++) {
+                        char partner = state[pairs[p].second];
+
+                        if (partner == KEPT) {
+                            decided = REMOVED;
+                            break;
+                        }
+
+                        waiting = waiting || (partner == UNDECIDED);
+                    }
+
+                    next[i] = (decided == REMOVED || !waiting) ? decided :
+                                                                UNDECIDED;
+                }
+            });
+
+            undecided = false;
+
+            for (size_t o=0; o<outranked.size(); o++) {
+                size_t i = outranked[o];
+                state[i] = next[i];
+                undecided = undecided || (state[i] == UNDECIDED);
+            }
+        }
+
+        // Counts per grain pair; a removed atom is charged to the first
+        // partner that stayed
+        for (size_t o=0; o<outranked.size(); o++) {
+            size_t i = outranked[o];
+            bool charged = (state[i] != REMOVED);
+
+            for (size_t p=first[o]; p<first[o+1]; p++) {
+                size_t j = pairs[p].second;
+                pair<int, int> key = minmax(view.grain[i], view.grain[j]);
+
+                Count &count = report.grains[key];
+                count.pairs++;
+
+                if (!charged && state[j] == KEPT) {
+                    count.removed++;
+                    charged = true;
+                }
+            }
+        }
+
+        // Keep the survivors in order
+        size_t kept = 0;
+
+        for (size_t i=0; i<atoms.size(); i++) {
+            if (state[i] == REMOVED)
+                continue;
+
+            atoms.x[kept] = atoms.x[i];
+            atoms.y[kept] = atoms.y[i];
+            atoms.z[kept] = atoms.z[i];
+            atoms.type[kept] = atoms.type[i];
+            atoms.grain[kept] = atoms.grain[i];
+            kept++;
+        }
+
+        report.removed = atoms.size() - kept;
+        atoms.resize(kept);
+
+        return report;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef OVERLAP_H
+#define OVERLAP_H
+
+#include <map>
+#include <utility>
+#include "Atoms.h"
+#include "Tools.h"
+
+using namespace std;
+
+/* Removal of atoms closer than a cutoff, such as the unphysically close
+ * pairs across grain boundaries that blow up the first steps of MD.
+ */
+namespace Overlap {
+
+    // Which atom of a close pair survives
+    enum Policy {
+        FIRST,              // the one earlier in the container
+        LOWER_GRAIN,        // the one of the lower grain id, then FIRST
+        HIGHER_GRAIN        // the one of the higher grain id, then FIRST
+    };
+
+    struct Count {
+        size_t pairs;       // pairs closer than the cutoff
+        size_t removed;     // atoms removed
+    };
+
+    struct Report {
+        size_t pairs;
+        size_t removed;
+
+        // Per (lower, higher) grain id pair; a removed atom counts for its
+        // own grain and the grain of the atom that outranked it
+        map<pair<int, int>, Count> grains;
+    };
+
+    Report removeClose(Atoms&, const Tools::Box&, double, Policy,
+                        int threads=1);
+}
+
+#endif
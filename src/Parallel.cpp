@@ -0,0 +1,256 @@
+/* Fork-join helpers for running independent work items on several threads.
+ *
+ * Author: Josh Vita
+ * Created: 2017/7
+ * Last edited: 2017/7
+ */
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <chrono>
+#include <exception>
+#include <algorithm>
+#include <functional>
+#include "Parallel.h"
+
+using namespace std;
+
+namespace {
+
+    // Runs 'work(t)' on threads [0,threads), the calling thread being 0,
+    // and rethrows the first exception once all have stopped
+    void runThreads(int threads, atomic<bool> &failed,
+                    const function<void(int)> &work) {
+        exception_ptr error;
+        mutex errorLock;
+
+        auto guarded = [&](int t) {
+            try {
+                work(t);
+            } catch (...) {
+                lock_guard<mutex> lock(errorLock);
+
+                if (!failed.exchange(true))
+                    error = current_exception();
+            }
+        };
+
+        vector<thread> pool;
+        pool.reserve(threads-1);
+
+        for (int t=1; t<threads; t++)
+            pool.push_back(thread(guarded, t));
+
+        guarded(0);
+
+        for (size_t t=0; t<pool.size(); t++)
+            pool[t].join();
+
+        if (error)
+            rethrow_exception(error);
+    }
+
+    void resetStats(Parallel::Stats *stats, int threads) {
+        if (!stats)
+            return;
+
+        stats->busy.assign(threads, 0.0);
+        stats->items.assign(threads, 0);
+        stats->steals = 0;
+    }
+
+    void timed(const function<void(int, int)> &body, int i, int t,
+                Parallel::Stats *stats) {
+        /* Runs one item, adding its time to the thread's account */
+
+        if (!stats) {
+            body(i, t);
+            return;
+        }
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        body(i, t);
+
+        chrono::duration<double> took = chrono::steady_clock::now() - start;
+        stats->busy[t] += took.count();
+        stats->items[t]++;
+    }
+
+    // Items owned by one thread; the owner takes from the front, thieves
+    // from the back
+    struct Queue {
+        mutex lock;
+        deque<int> items;
+    };
+}
+
+namespace Parallel {
+
+    double Stats::imbalance() const {
+        /* Busiest thread's time over the mean; 1 is perfect balance */
+
+        if (busy.empty())
+            return 1.0;
+
+        double total = 0;
+        double most = 0;
+
+        for (size_t t=0; t<busy.size(); t++) {
+            total += busy[t];
+            most = max(most, busy[t]);
+        }
+
+        return (total > 0) ? most*busy.size()/total : 1.0;
+    }
+
+    void InOrder::reset(int n, const function<void(int)> &callback) {
+        /* Starts a new sequence of items [0,n) */
+
+        ready.assign(n, 0);
+        next = 0;
+        emit = callback;
+    }
+
+    void InOrder::done(int item) {
+        /* Marks 'item' finished; thread-safe. Emits run one at a time, so
+         * 'emit' needs no locking of its own. */
+
+        lock_guard<mutex> guard(lock);
+
+        ready[item] = 1;
+
+        while (next < static_cast<int>(ready.size()) && ready[next]) {
+            emit(next);
+            next++;
+        }
+    }
+
+    int defaultThreads() {
+        /* Number of hardware threads, or 1 if it cannot be determined */
+
+        return max(1u, thread::hardware_concurrency());
+    }
+
+    void forEach(int n, int threads, const function<void(int, int)> &body,
+                    Stats *stats) {
+        /* Runs body(item, thread) for every item in [0,n). Items are handed
+         * out one at a time from a shared counter, so uneven items still
+         * keep every thread busy. The calling thread takes part, so
+         * 'threads' is the total number of threads working. An exception
+         * thrown by any item is rethrown here once all threads have
+         * stopped.
+         *
+         * Args:
+         *  n       -   number of work items
+         *  threads -   threads to use; at most n are started
+         *  body    -   work for one item; the second argument is the index
+         *              of the thread running it, in [0,threads), for
+         *              picking per-thread scratch buffers
+         *  stats   -   optional; receives per-thread time and item counts
+         */
+
+        threads = max(1, min(threads, n));
+        resetStats(stats, threads);
+
+        atomic<int> next(0);
+        atomic<bool> failed(false);
+
+        runThreads(threads, failed, [&](int t) {
+            for (int i=next++; i<n && !failed; i=next++)
+                timed(body, i, t, stats);
+        });
+    }
+
+    void forEachStealing(int n, int threads,
+                            const function<void(int, int)> &body,
+                            Stats *stats) {
+        /* Same contract as forEach, but with work stealing: every thread
+         * starts with its own contiguous block of items, so neighboring
+         * items (e.g. adjacent tiles) run on the same thread. A thread that
+         * runs dry steals half of the remaining items of another thread,
+         * from the far end of its block, and carries on until no thread has
+         * work left.
+         *
+         * Args:
+         *  n       -   number of work items
+         *  threads -   threads to use; at most n are started
+         *  body    -   work for one item, given (item, thread)
+         *  stats   -   optional; receives per-thread time, item counts and
+         *              the number of stolen items
+         */
+
+        threads = max(1, min(threads, n));
+        resetStats(stats, threads);
+
+        vector<Queue> queues(threads);
+
+        for (int t=0; t<threads; t++) {
+            int first = static_cast<int>(static_cast<long>(n)*t/threads);
+            int last = static_cast<int>(static_cast<long>(n)*(t+1)/threads);
+
+            for (int i=first; i<last; i++)
+                queues[t].items.push_back(i);
+        }
+
+        atomic<bool> failed(false);
+        atomic<int> steals(0);
+
+        runThreads(threads, failed, [&](int t) {
+            Queue &own = queues[t];
+
+            while (!failed) {
+                int item = -1;
+
+                {
+                    lock_guard<mutex> lock(own.lock);
+
+                    if (!own.items.empty()) {
+                        item = own.items.front();
+                        own.items.pop_front();
+                    }
+                }
+
+                // Out of work: look for a victim, nearest thread first
+                for (int v=1; v<threads && item < 0; v++) {
+                    Queue &victim = queues[(t+v) % threads];
+                    deque<int> loot;
+
+                    {
+                        lock_guard<mutex> lock(victim.lock);
+
+                        size_t take = (victim.items.size()+1)/2;
+
+                        for (size_t k=0; k<take; k++) {
+                            loot.push_front(victim.items.back());
+                            victim.items.pop_back();
+                        }
+                    }
+
+                    if (loot.empty())
+                        continue;
+
+                    steals += static_cast<int>(loot.size());
+                    item = loot.front();
+                    loot.pop_front();
+
+                    lock_guard<mutex> lock(own.lock);
+                    own.items.insert(own.items.end(), loot.begin(),
+                                        loot.end());
+                }
+
+                // Items are never added, so empty everywhere means done
+                if (item < 0)
+                    break;
+
+                timed(body, item, t, stats);
+            }
+        });
+
+        if (stats)
+            stats->steals = steals;
+    }
+}
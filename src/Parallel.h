@@ -0,0 +1,122 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+
+/* Minimal fork-join helpers on top of std::thread. Which thread runs an item
+ * is not deterministic; callers that need reproducible output write each
+ * item's result to its own slot and merge the slots in item order.
+ */
+namespace Parallel {
+
+    // Per-thread accounting of a parallel loop, for load balance reports
+    struct Stats {
+        vector<double> busy;        // seconds spent in the loop body
+        vector<int> items;          // items run
+        int steals;                 // items taken from another thread
+
+        double imbalance() const;
+    };
+
+    /* Hands items finished in any order to 'emit' in index order. Whoever
+     * completes the next missing item emits it and every ready item after
+     * it, so only items finished out of order wait in memory.
+     */
+    struct InOrder {
+        mutex lock;
+        vector<char> ready;
+        int next;
+        function<void(int)> emit;
+
+        void reset(int, const function<void(int)>&);
+
+        void done(int);
+    };
+
+    /* Blocking FIFO of at most 'capacity' items between producer and
+     * consumer threads. push() waits while the queue is full, which holds
+     * fast producers back instead of letting memory grow; pop() waits while
+     * it is empty and returns false once the queue is closed and drained.
+     * The length is sampled at every push, for occupancy reports.
+     */
+    template<class T>
+    struct BoundedQueue {
+        mutex lock;
+        condition_variable changed;
+        deque<T> items;
+        size_t capacity;
+        bool closed;
+
+        size_t pushes;
+        size_t lengthSum;           // sum of the lengths after each push
+        size_t longest;
+
+        void reset(size_t cap) {
+            items.clear();
+            capacity = max(cap, static_cast<size_t>(1));
+            closed = false;
+            pushes = 0;
+            lengthSum = 0;
+            longest = 0;
+        }
+
+        void push(T item) {
+            unique_lock<mutex> guard(lock);
+            changed.wait(guard, [&]() {
+                return items.size() < capacity || closed;
+            });
+
+            if (closed)
+                return;
+
+            items.push_back(move(item));
+
+            pushes++;
+            lengthSum += items.size();
+            longest = max(longest, items.size());
+
+            changed.notify_all();
+        }
+
+        bool pop(T &item) {
+            unique_lock<mutex> guard(lock);
+            changed.wait(guard, [&]() { return !items.empty() || closed; });
+
+            if (items.empty())
+                return false;
+
+            item = move(items.front());
+            items.pop_front();
+
+            changed.notify_all();
+            return true;
+        }
+
+        // No more pushes; consumers drain what is left, then stop
+        void close() {
+            lock_guard<mutex> guard(lock);
+            closed = true;
+            changed.notify_all();
+        }
+
+        double meanLength() const {
+            return pushes ? static_cast<double>(lengthSum)/pushes : 0.0;
+        }
+    };
+
+    int defaultThreads();
+
+    void forEach(int, int, const function<void(int, int)>&, Stats *stats=nullptr);
+
+    void forEachStealing(int, int, const function<void(int, int)>&,
+                            Stats *stats=nullptr);
+}
+
+#endif
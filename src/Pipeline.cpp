@@ -0,0 +1,274 @@
+/* Pipelined generation and output of atom chunks.
+ *
+ * Author: Josh Vita
+ * Created: 2017/7
+ * Last edited: 2017/7
+ */
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include "Atoms.h"
+#include "Lammps.h"
+#include "Parallel.h"
+#include "Pipeline.h"
+
+using namespace std;
+
+namespace {
+
+    typedef chrono::steady_clock Clock;
+
+    double since(Clock::time_point start) {
+        chrono::duration<double> took = Clock::now() - start;
+        return took.count();
+    }
+
+    Pipeline::Stage total(const vector<double> &busy,
+                            const vector<double> &waiting) {
+        Pipeline::Stage stage;
+        stage.threads = static_cast<int>(busy.size());
+        stage.busy = 0;
+        stage.waiting = 0;
+
+        for (size_t t=0; t<busy.size(); t++) {
+            stage.busy += busy[t];
+            stage.waiting += waiting[t];
+        }
+
+        return stage;
+    }
+}
+
+namespace Pipeline {
+
+    string Report::bottleneck() const {
+        /* Name of the stage with the most work per thread; the others
+         * spend the difference waiting on it */
+
+        double gen = generate.busy/max(generate.threads, 1);
+        double fmt = format.busy/max(format.threads, 1);
+        double io = write.busy/max(write.threads, 1);
+
+        if (gen >= fmt && gen >= io)
+            return "generate";
+
+        return (fmt >= io) ? "format" : "write";
+    }
+
+    Report run(int n, int genThreads, int fmtThreads, int window,
+                const function<void(int, int, Atoms&)> &generate,
+                Lammps::Writer &writer) {
+        /* Generates chunks [0,n) and writes them to 'writer' in index
+         * order; the file is the same as writing each chunk with
+         * writer.write() in turn.
+         *
+         * Chunks are handed to generators in index order. Once every chunk
+         * before it is generated a chunk's first atom id is known, and it
+         * is queued for formatting; formatted chunks are queued for the
+         * writer in index order again. The writer frees a slot of the
+         * window for every chunk it writes.
+         *
+         * Args:
+         *  n           -   number of chunks
+         *  genThreads  -   threads generating; the calling thread is one
+         *  fmtThreads  -   threads formatting
+         *  window      -   most chunks in flight at once
+         *  generate    -   generate(chunk, thread, out) appends the atoms
+         *                  of a chunk to 'out'; 'thread' is in
+         *                  [0,genThreads), for picking scratch buffers
+         *  writer      -   open writer receiving the atoms
+         *
+         * Returns:
+         *  report      -   time per stage and queue occupancy
+         *
+         * Throws:
+         *  the first exception of any stage, once all have stopped
+         */
+
+        genThreads = max(1, min(genThreads, n));
+        fmtThreads = max(1, min(fmtThreads, n));
+        window = max(window, 1);
+
+        vector<Atoms> chunks(n);
+        vector<string> texts(n);
+        vector<size_t> firstId(n);
+        vector<size_t> counts(n);
+        vector<int> maxType(n, 0);
+
+        Parallel::BoundedQueue<int> toFormat;
+        Parallel::BoundedQueue<int> toWrite;
+        toFormat.reset(window);
+        toWrite.reset(window);
+
+        // Chunk ids are settled in order as generation finishes...
+        size_t nextId = writer.nAtoms + 1;
+        Parallel::InOrder generated;
+        generated.reset(n, [&](int c) {
+            firstId[c] = nextId;
+            nextId += chunks[c].size();
+            toFormat.push(c);
+        });
+
+        // ... and the writer gets formatted chunks in order too
+        Parallel::InOrder formatted;
+        formatted.reset(n, [&](int c) { toWrite.push(c); });
+
+        // Window of chunks in flight, guarding the next chunk to start
+        mutex slotLock;
+        condition_variable slotFreed;
+        int started = 0;
+        int inFlight = 0;
+
+        // First error of any stage; stops the others
+        atomic<bool> failed(false);
+        exception_ptr error;
+        mutex errorLock;
+
+        auto fail = [&]() {
+            {
+                lock_guard<mutex> guard(errorLock);
+
+                if (!failed.exchange(true))
+                    error = current_exception();
+            }
+
+            {
+                lock_guard<mutex> guard(slotLock);
+                slotFreed.notify_all();
+            }
+
+            toFormat.close();
+            toWrite.close();
+        };
+
+        vector<double> genBusy(genThreads, 0.0), genWait(genThreads, 0.0);
+        vector<double> fmtBusy(fmtThreads, 0.0), fmtWait(fmtThreads, 0.0);
+        vector<double> ioBusy(1, 0.0), ioWait(1, 0.0);
+
+        thread io([&]() {
+            try {
+                for (;;) {
+                    Clock::time_point t0 = Clock::now();
+                    int c;
+
+                    if (!toWrite.pop(c))
+                        break;
+
+                    Clock::time_point t1 = Clock::now();
+                    ioWait[0] += chrono::duration<double>(t1 - t0).count();
+
+                    writer.append(texts[c], counts[c], maxType[c]);
+                    string().swap(texts[c]);
+
+                    ioBusy[0] += since(t1);
+
+                    lock_guard<mutex> guard(slotLock);
+                    inFlight--;
+                    slotFreed.notify_all();
+                }
+            } catch (...) {
+                fail();
+            }
+        });
+
+        thread formatters([&]() {
+            Parallel::forEach(fmtThreads, fmtThreads, [&](int, int t) {
+                vector<double> scratch;
+
+                try {
+                    for (;;) {
+                        Clock::time_point t0 = Clock::now();
+                        int c;
+
+                        if (!toFormat.pop(c))
+                            break;
+
+                        Clock::time_point t1 = Clock::now();
+                        fmtWait[t] +=
+                            chrono::duration<double>(t1 - t0).count();
+
+                        Atoms &atoms = chunks[c];
+
+                        for (size_t a=0; a<atoms.size(); a++)
+                            maxType[c] = max(maxType[c], atoms.type[a]);
+
+                        writer.format(texts[c], atoms.view(), firstId[c],
+                                        scratch);
+                        counts[c] = atoms.size();
+                        chunks[c] = Atoms();
+
+                        fmtBusy[t] += since(t1);
+
+                        formatted.done(c);
+                    }
+                } catch (...) {
+                    fail();
+                }
+            });
+        });
+
+        Parallel::forEach(genThreads, genThreads, [&](int, int t) {
+            try {
+                while (!failed) {
+                    Clock::time_point t0 = Clock::now();
+                    int c;
+
+                    {
+                        unique_lock<mutex> guard(slotLock);
+                        slotFreed.wait(guard, [&]() {
+                            return inFlight < window || started >= n ||
+                                    failed;
+                        });
+
+                        if (started >= n || failed)
+                            break;
+
+                        c = started++;
+                        inFlight++;
+                    }
+
+                    Clock::time_point t1 = Clock::now();
+                    genWait[t] += chrono::duration<double>(t1 - t0).count();
+
+                    generate(c, t, chunks[c]);
+
+                    genBusy[t] += since(t1);
+
+                    generated.done(c);
+                }
+            } catch (...) {
+                fail();
+            }
+        });
+
+        // Every chunk is queued for formatting once all generators stop
+        toFormat.close();
+        formatters.join();
+
+        toWrite.close();
+        io.join();
+
+        if (error)
+            rethrow_exception(error);
+
+        Report report;
+        report.generate = total(genBusy, genWait);
+        report.format = total(fmtBusy, fmtWait);
+        report.write = total(ioBusy, ioWait);
+        report.window = window;
+        report.formatQueueMean = toFormat.meanLength();
+        report.formatQueueMax = toFormat.longest;
+        report.writeQueueMean = toWrite.meanLength();
+        report.writeQueueMax = toWrite.longest;
+
+        return report;
+    }
+}
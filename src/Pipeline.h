@@ -0,0 +1,47 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <string>
+#include <functional>
+#include "Atoms.h"
+#include "Lammps.h"
+
+using namespace std;
+
+/* Generate -> format -> write pipeline. Chunks of atoms (grains or tiles)
+ * are generated by one group of threads, turned into text by a second
+ * group and written by a single I/O thread, so disk writes overlap with
+ * compute. At most 'window' chunks are in flight between being started and
+ * being written, which bounds the memory held by the queues: generators
+ * wait for the writer when they get too far ahead.
+ */
+namespace Pipeline {
+
+    // Time spent by one stage, summed over its threads
+    struct Stage {
+        int threads;
+        double busy;                // seconds doing the stage's work
+        double waiting;             // seconds blocked on the neighbors
+    };
+
+    struct Report {
+        Stage generate;
+        Stage format;
+        Stage write;
+        int window;                 // chunks allowed in flight
+
+        // Chunks waiting for a formatter, and formatted chunks waiting
+        // for the writer, sampled whenever one is queued
+        double formatQueueMean;
+        size_t formatQueueMax;
+        double writeQueueMean;
+        size_t writeQueueMax;
+
+        string bottleneck() const;
+    };
+
+    Report run(int, int, int, int, const function<void(int, int, Atoms&)>&,
+                Lammps::Writer&);
+}
+
+#endif
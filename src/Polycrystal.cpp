@@ -0,0 +1,197 @@
+/* A polycrystal held in memory, regenerated grain by grain as it is edited.
+ *
+ * Author: Josh Vita
+ * Created: 2017/7
+ * Last edited: 2017/7
+ */
+
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "Atoms.h"
+#include "Tools.h"
+#include "Grid.h"
+#include "Classify.h"
+#include "Voronoi.h"
+#include "Grain.h"
+#include "Parallel.h"
+#include "Lammps.h"
+#include "Polycrystal.h"
+
+using namespace std;
+
+namespace {
+
+    // Up to this many grains a vectorized scan over the centers finds the
+    // owner of a site faster than the bucket grid, as in main()
+    const size_t MAX_SCAN_GRAINS = 32;
+
+    void merge(vector<int> &ids, const vector<int> &more) {
+        /* Sorted union of two sorted id lists, into 'ids' */
+
+        vector<int> both;
+        set_union(ids.begin(), ids.end(), more.begin(), more.end(),
+                    back_inserter(both));
+        ids.swap(both);
+    }
+}
+
+namespace Polycrystal {
+
+    void Model::build(const vector<Tools::Vec3> &c,
+                        const vector<Tools::Mat3> &r, Tools::Vec3 len,
+                        Generator generator, int nThreads) {
+        /* Generates every grain
+         *
+         * Args:
+         *  c           -   grain centers, inside the box
+         *  r           -   crystal to lab rotation of each grain
+         *  len         -   box edge lengths; the box starts at the origin
+         *  generator   -   fills a cell with the lattice
+         *  nThreads    -   threads to generate with
+         *
+         * Throws:
+         *  invalid_argument if there are no grains or the rotations do not
+         *  match the centers
+         */
+
+        if (c.empty() || c.size() != r.size())
+            throw invalid_argument("need one rotation for every center");
+
+        box = Tools::Box {Tools::Vec3 {0,0,0}, len, 0, 0, 0};
+        centers = c;
+        rotations = r;
+        fill = generator;
+        threads = max(1, nThreads);
+
+        // Grain buffers are kept, so a model rebuilt for another structure
+        // of similar size allocates little
+        cells.assign(centers.size(), Voronoi::Cell());
+        grains.resize(centers.size());
+        scratch.resize(threads);
+
+        vector<int> all(centers.size());
+
+        for (size_t g=0; g<all.size(); g++)
+            all[g] = g;
+
+        index();
+        regenerate(all, true);
+    }
+
+    vector<int> Model::moveCenter(int g, Tools::Vec3 center) {
+        /* Moves the center of grain g. Only cells with a face between
+         * themselves and g can change, so g and its neighbors before and
+         * after the move are rebuilt and refilled; every other grain keeps
+         * its atoms.
+         *
+         * Args:
+         *  g           -   grain to move
+         *  center      -   new center; wrapped into the box
+         *
+         * Returns:
+         *  ids         -   sorted ids of the regenerated grains
+         */
+
+        vector<int> affected = cells[g].neighbors;
+        affected.push_back(g);
+        sort(affected.begin(), affected.end());
+
+        centers[g] = Tools::wrap(center, box);
+        index();
+
+        // The new neighbors are known once the cell itself is rebuilt
+        cells[g] = Voronoi::computeCell(centers, grid, g);
+        merge(affected, cells[g].neighbors);
+
+        regenerate(affected, true);
+
+        return affected;
+    }
+
+    vector<int> Model::rotate(int g, const Tools::Mat3 &rotMat) {
+        /* Gives grain g a new orientation. Cells only depend on the
+         * centers, so nothing else changes.
+         *
+         * Returns:
+         *  ids         -   the regenerated grain, g
+         */
+
+        rotations[g] = rotMat;
+        regenerate(vector<int>(1, g), false);
+
+        return vector<int>(1, g);
+    }
+
+    vector<size_t> Model::offsets() const {
+        /* Index of the first atom of each grain in the output, which holds
+         * the grains in id order; the last entry is the number of atoms */
+
+        vector<size_t> first(grains.size() + 1, 0);
+
+        for (size_t g=0; g<grains.size(); g++)
+            first[g+1] = first[g] + grains[g].size();
+
+        return first;
+    }
+
+    size_t Model::size() const {
+        return offsets().back();
+    }
+
+    void Model::write(Lammps::Writer &writer) {
+        /* Writes the grains in id order to an open writer */
+
+        for (size_t g=0; g<grains.size(); g++)
+            writer.write(grains[g].view());
+    }
+
+    void Model::regenerate(const vector<int> &ids, bool rebuildCells) {
+        /* Refills grains, in parallel
+         *
+         * Args:
+         *  ids             -   grains to refill
+         *  rebuildCells    -   whether their cells are out of date too
+         */
+
+        Parallel::forEach(ids.size(), threads, [&](int i, int t) {
+            int g = ids[i];
+
+            if (rebuildCells)
+                cells[g] = Voronoi::computeCell(centers, grid, g);
+
+            Atoms &out = grains[g];
+            Atoms &edge = scratch[t].edge;
+            vector<int> &owner = scratch[t].owner;
+
+            out.clear();
+            edge.clear();
+
+            fill(out, edge, cells[g], rotations[g], box, scratch[t]);
+
+            // Only sites on the cell boundary need the classifier
+            AtomView e = edge.view();
+            owner.resize(e.size());
+
+            if (useScan)
+                Classify::nearest(e, packed, owner.data(), g);
+            else
+                Classify::nearest(e, grid, owner.data());
+
+            Grain::keepOwnCell(edge, owner, g, centers[g], box);
+
+            out.append(edge.view());
+        });
+    }
+
+    void Model::index() {
+        /* Rebuilds the center lookups after the centers change. This is
+         * linear in the number of grains, not atoms. */
+
+        useScan = centers.size() <= MAX_SCAN_GRAINS;
+        grid.build(centers, box.len);
+
+        if (useScan)
+            packed = Classify::pack(centers, box);
+    }
+}
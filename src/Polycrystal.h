@@ -0,0 +1,94 @@
+#ifndef POLYCRYSTAL_H
+#define POLYCRYSTAL_H
+
+#include <vector>
+#include <functional>
+#include "Atoms.h"
+#include "Tools.h"
+#include "Grid.h"
+#include "Classify.h"
+#include "Voronoi.h"
+#include "Grain.h"
+#include "Lammps.h"
+
+using namespace std;
+
+/* A generated polycrystal kept in memory for editing. Every grain's atoms
+ * are held on their own, and the Voronoi cells give the grain adjacency,
+ * so changing one grain only regenerates the grains whose cells can
+ * change: the grain itself and its neighbors before and after the edit.
+ * The box is periodic and orthorhombic with its lower corner at the
+ * origin, as in main().
+ */
+namespace Polycrystal {
+
+    // Fills a cell with a lattice of the given orientation, splitting the
+    // sites into 'inside' and 'edge' as Grain::genGrainInCell does
+    typedef function<void(Atoms&, Atoms&, const Voronoi::Cell&,
+                            const Tools::Mat3&, const Tools::Box&,
+                            Grain::Scratch&)> Generator;
+
+    struct Model {
+        Tools::Box box;
+        vector<Tools::Vec3> centers;
+        vector<Tools::Mat3> rotations;
+        vector<Voronoi::Cell> cells;
+        Generator fill;
+        int threads;
+
+        // Atoms of each grain, wrapped into the box and tagged with its id
+        vector<Atoms> grains;
+
+        // Owner lookup of edge sites: a scan for few grains, else the grid
+        bool useScan;
+        CenterGrid grid;
+        Classify::Centers packed;
+
+        vector<Grain::Scratch> scratch;
+
+        void build(const vector<Tools::Vec3>&, const vector<Tools::Mat3>&,
+                    Tools::Vec3, Generator, int threads=1);
+
+        vector<int> moveCenter(int, Tools::Vec3);
+
+        vector<int> rotate(int, const Tools::Mat3&);
+
+        vector<size_t> offsets() const;
+
+        size_t size() const;
+
+        void write(Lammps::Writer&);
+
+        void regenerate(const vector<int>&, bool);
+
+        void index();
+    };
+
+    template<class L>
+    Generator lattice(double latConst, const int (&types)[L::nSub]) {
+        /* Generator of a compile-time lattice (see Lattice.h)
+         *
+         * Args:
+         *  latConst    -   the lattice constant
+         *  types       -   atom type of each sublattice
+         */
+
+        vector<int> copy(types, types + L::nSub);
+
+        return [latConst, copy](Atoms &inside, Atoms &edge,
+                                const Voronoi::Cell &cell,
+                                const Tools::Mat3 &rotMat,
+                                const Tools::Box &box,
+                                Grain::Scratch &scratch) {
+            int t[L::nSub];
+
+            for (int s=0; s<L::nSub; s++)
+                t[s] = copy[s];
+
+            Grain::genGrainInCell<L>(inside, edge, cell, latConst, t, rotMat,
+                                        box, nullptr, &scratch);
+        };
+    }
+}
+
+#endif
@@ -10,174 +10,778 @@
 #include <iostream>
 #include <cmath>
 #include <cstdlib>
-#include <time.h>
 #include <string>
+#include <chrono>
+#include <stdexcept>
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
 #include "define.h"
 #include "Tools.h"
 #include "Grain.h"
 #include "Lammps.h"
+#include "Atoms.h"
+#include "Grid.h"
+#include "Classify.h"
+#include "Voronoi.h"
+#include "Lattice.h"
+#include "Parallel.h"
+#include "Tiles.h"
+#include "Random.h"
+#include "Memory.h"
+#include "Pipeline.h"
+#include "Binary.h"
+#include "Overlap.h"
+#include "Boundary.h"
+#include "Polycrystal.h"
+#include "Batch.h"
+#include "Regrain.h"
+#include "Pv3d.h"
 
 
-//TODO: genGrain, use the cube that encapsulates the sphere... that encapsulates
-//the smaller cube
 using namespace std;
 
+namespace {
+
+    // Rocksalt; to change the structure pick another lattice from
+    // Lattice.h. 'TYPES' holds the atom type of each sublattice.
+    typedef Lattice::B1 Structure;
+    const int TYPES[Structure::nSub] = {1, 2};
+
+    int readInt(const string &name, const string &value, int least) {
+        /* Parses an integer option value of at least 'least' */
+
+        size_t used = 0;
+        int n = 0;
+
+        try {
+            n = stoi(value, &used);
+        } catch (const exception&) {
+            used = 0;
+        }
+
+        if (used == 0 || used != value.size() || n < least)
+            throw invalid_argument("bad value '" + value + "' for " + name);
+
+        return n;
+    }
+
+    uint64_t readSeed(const string &name, const string &value) {
+        /* Parses an unsigned 64-bit option value */
+
+        size_t used = 0;
+        uint64_t n = 0;
+
+        try {
+            if (!value.empty() && value[0] != '-')
+                n = stoull(value, &used);
+        } catch (const exception&) {
+            used = 0;
+        }
+
+        if (used == 0 || used != value.size())
+            throw invalid_argument("bad value '" + value + "' for " + name);
+
+        return n;
+    }
+
+    double readDouble(const string &name, const string &value) {
+        /* Parses a non-negative floating point option value */
+
+        size_t used = 0;
+        double x = -1;
+
+        try {
+            x = stod(value, &used);
+        } catch (const exception&) {
+            used = 0;
+        }
+
+        if (used == 0 || used != value.size() || !(x >= 0))
+            throw invalid_argument("bad value '" + value + "' for " + name);
+
+        return x;
+    }
+
+    vector<int> readList(const string &name, const string &value) {
+        /* Parses a comma separated list of non-negative integers */
+
+        vector<int> list;
+        size_t start = 0;
+
+        for (;;) {
+            size_t comma = value.find(',', start);
+            list.push_back(readInt(name, value.substr(start, comma - start),
+                                    0));
+
+            if (comma == string::npos)
+                return list;
+
+            start = comma + 1;
+        }
+    }
+}
+
 namespace Pv3d {
 
-    bool inBox(dvec_t p, vector<dvec_t> boxDims) {
-        /* Returns 'true' if the point falls within the rectangular box
+    vector<Tools::Vec3> genCenters(int nCenters, Tools::Vec3 boxDims,
+                                    uint64_t seed) {
+        /* Randomly generates 'nCenters' number of points within 'boxDims'.
+         * Center i is drawn from its own stream, so it depends only on the
+         * seed and i.
          *
          * Args:
-         *  p           -   the point to check
-         *  boxDims     -   box dimensions; organized as {(xlo,xhi), (ylo,yhi),
-         *                  (zlo,zhi)}
+         *  nCenters    -   the number of points to generate
+         *  boxDims     -   xyz bounds of box (assumes origin as lower bound)
+         *  seed        -   run seed
          *
          * Returns:
-         *  true if point is in box
+         *  centers     -   a set of xyz coordinates (no atom info)
          */
 
-        bool in = ( (p[1] >= boxDims[0][0] && p[1] <= boxDims[0][1]) && 
-                    (p[2] >= boxDims[1][0] && p[2] <= boxDims[1][1]) &&
-                    (p[3] >= boxDims[2][0] && p[3] <= boxDims[2][1]));
+        vector<Tools::Vec3> centers;
+        centers.reserve(nCenters);
+
+        for (int i=0; i<nCenters; i++) {
+            Random::Stream s = Random::stream(seed, i, Random::CENTER);
+            Tools::Vec3 temp;
+
+            temp.x = s.uniform() * boxDims.x;
+            temp.y = s.uniform() * boxDims.y;
+            temp.z = s.uniform() * boxDims.z;
 
-        return in;
+            centers.push_back(temp);
+        }
+
+        return centers;
     }
 
-    bool inRegion(dvec_t p, vector<dvec_t> centers, int regionId) {
-        /* Checks to see if point 'p' falls into the Voronoi tile specified by
-         * regionId.
+    Options parseArgs(int argc, char *argv[]) {
+        /* Reads the command line options. Values follow their option either
+         * as the next argument or after '='; flags take no value.
+         *
+         *  --threads N     threads to use (default: hardware threads)
+         *  --tiles N       split the box into N^3 tiles and fill those in
+         *                  parallel instead of whole grains (default: 0, by
+         *                  grain)
+         *  --seed N        random seed (default: from the clock)
+         *  --precision N   digits after the decimal point in the output
+         *                  (default: 6)
+         *  --pipeline      generate, format and write in separate stages
+         *                  connected by bounded queues, so writing overlaps
+         *                  with generation
+         *  --format-threads N
+         *                  formatting threads of the pipeline (default: a
+         *                  quarter of --threads, at least 1)
+         *  --compress C    'gzip' or 'none' (default: gzip if the output
+         *                  file name ends in .gz)
+         *  --sort C        'morton', 'hilbert' or 'none': order the atoms
+         *                  along a space-filling curve over the box, and
+         *                  number them in that order (default: none, by
+         *                  grain). Holds every atom in memory until written.
+         *  --overlap R     remove one atom of every pair closer than R
+         *                  (default: 0, none). Holds every atom in memory
+         *                  until written.
+         *  --overlap-policy P
+         *                  which atom of a close pair stays: 'first' in
+         *                  the output, 'lower' or 'higher' grain id
+         *                  (default: lower)
+         *  --gb-distance   end every atom line of the data file with a
+         *                  comment holding the distance from the atom to
+         *                  the nearest boundary of its grain
+         *  --gb-tag D      end it with a comment instead that is 1 for
+         *                  atoms within D of their grain's boundary and 0
+         *                  for the rest
+         *  --batch FILE    generate every realization listed in FILE
+         *                  instead of one read from the terminal (see
+         *                  Batch.h)
+         *  --job LINE      one more batch job line; may be repeated
+         *  --concurrent K  realizations of a batch generated at once, each
+         *                  with its share of --threads (default: 1)
+         *  --regrain IN OUT
+         *                  assign every atom of IN, a data file or binary
+         *                  file, to the grain of its nearest center, write
+         *                  the result to OUT and exit; needs --centers or
+         *                  --grains
+         *  --centers FILE  grain centers for --regrain, one "x y z" per
+         *                  line
+         *  --grains N      N random centers for --regrain, from --seed
+         *  --keep LIST     with --regrain, keep only the atoms of the
+         *                  grains in the comma separated LIST
+         *  --retype        with --regrain, make each atom's type its
+         *                  grain id + 1
+         *  --convert IN OUT
+         *                  convert IN between the binary format and a
+         *                  LAMMPS data file, whichever it is not, and exit
+         *
+         * Output files whose names end in .pv3d are written in the binary
+         * format (see Binary.h) instead of as LAMMPS data files.
          *
          * Args:
-         *  p           -   xyz coordinates of checked point (with atom type
-         *                  info)
-         *  centers     -   collection of all tile centers
-         *  regionId    -   tile id to be checked
+         *  argc, argv  -   as passed to main
          *
          * Returns:
-         *  'true' if point is in tile
+         *  options     -   defaults for anything not given
+         *
+         * Throws:
+         *  invalid_argument for unknown options or bad values
          */
 
-        // Instantiate to first distance
-        dvec_t t1 = centers[0];
-        dvec_t diff = {t1[0]-p[1], t1[1]-p[2], t1[2]-p[3]};     // p has atom
-                                                                // type info
-        double smallestDist = sqrt(diff[0]*diff[0] + diff[1]*diff[1] +
-                                        diff[2]*diff[2]);
-        int closestCenter = 0;
+        Options opts;
+        opts.threads = Parallel::defaultThreads();
+        opts.tiles = 0;
+        opts.seed = Random::timeSeed();
+        opts.precision = 6;
+        opts.pipeline = false;
+        opts.formatThreads = 0;
+        opts.compression = Lammps::BY_NAME;
+        opts.sort = Order::NONE;
+        opts.overlap = 0;
+        opts.overlapPolicy = Overlap::LOWER_GRAIN;
+        opts.gbDistance = false;
+        opts.gbTag = 0;
+        opts.concurrent = 1;
+        opts.grains = 0;
+        opts.retype = false;
+
+        for (int a=1; a<argc; a++) {
+            string name = argv[a];
+            string value;
+            size_t eq = name.find('=');
+
+            if (name == "--pipeline") {
+                opts.pipeline = true;
+                continue;
+            }
+
+            if (name == "--gb-distance") {
+                opts.gbDistance = true;
+                continue;
+            }
+
+            if (name == "--retype") {
+                opts.retype = true;
+                continue;
+            }
+
+            if (name == "--regrain") {
+                if (a+2 >= argc)
+                    throw invalid_argument(name + " needs two file names");
 
-        // Compare against every other distance
-        for (vector<dvec_t>::size_type i=1; i<centers.size(); i++) {
-            t1 = centers[i];
-            dvec_t diff = {t1[0]-p[1], t1[1]-p[2], t1[2]-p[3]};
+                opts.regrainFrom = argv[++a];
+                opts.regrainTo = argv[++a];
+                continue;
+            }
 
-            double checkDist = sqrt(diff[0]*diff[0] + diff[1]*diff[1] +
-                                        diff[2]*diff[2]);
+            if (name == "--convert") {
+                if (a+2 >= argc)
+                    throw invalid_argument(name + " needs two file names");
 
-            // Update distance and ID if closer
-            if (checkDist < smallestDist) {
-                smallestDist = checkDist;
+                opts.convertFrom = argv[++a];
+                opts.convertTo = argv[++a];
+                continue;
+            }
 
-                // Each block of 27 corresponds to one 'family' of regions
-                closestCenter = static_cast<int>(floor(i/27));
+            if (eq != string::npos) {
+                value = name.substr(eq+1);
+                name = name.substr(0, eq);
+            } else if (a+1 < argc) {
+                value = argv[++a];
+            } else if (name == "--threads" || name == "--tiles" ||
+                        name == "--seed" || name == "--precision" ||
+                        name == "--format-threads" || name == "--compress" ||
+                        name == "--sort" || name == "--overlap" ||
+                        name == "--overlap-policy" || name == "--gb-tag" ||
+                        name == "--batch" || name == "--job" ||
+                        name == "--concurrent" || name == "--centers" ||
+                        name == "--grains" || name == "--keep") {
+                throw invalid_argument(name + " needs a value");
+            }
+
+            if (name == "--threads") {
+                opts.threads = readInt(name, value, 1);
+            } else if (name == "--tiles") {
+                opts.tiles = readInt(name, value, 0);
+            } else if (name == "--seed") {
+                opts.seed = readSeed(name, value);
+            } else if (name == "--precision") {
+                opts.precision = readInt(name, value, 0);
+
+                if (opts.precision > 17)
+                    throw invalid_argument("--precision is at most 17");
+            } else if (name == "--format-threads") {
+                opts.formatThreads = readInt(name, value, 1);
+            } else if (name == "--overlap") {
+                opts.overlap = readDouble(name, value);
+            } else if (name == "--centers") {
+                opts.centersFile = value;
+            } else if (name == "--grains") {
+                opts.grains = readInt(name, value, 1);
+            } else if (name == "--keep") {
+                opts.keepGrains = readList(name, value);
+            } else if (name == "--batch") {
+                opts.batchFile = value;
+            } else if (name == "--job") {
+                opts.jobs.push_back(value);
+            } else if (name == "--concurrent") {
+                opts.concurrent = readInt(name, value, 1);
+            } else if (name == "--gb-tag") {
+                opts.gbTag = readDouble(name, value);
+
+                if (opts.gbTag == 0)
+                    throw invalid_argument("--gb-tag must be positive");
+            } else if (name == "--overlap-policy") {
+                if (value == "first")
+                    opts.overlapPolicy = Overlap::FIRST;
+                else if (value == "lower")
+                    opts.overlapPolicy = Overlap::LOWER_GRAIN;
+                else if (value == "higher")
+                    opts.overlapPolicy = Overlap::HIGHER_GRAIN;
+                else
+                    throw invalid_argument("bad value '" + value + "' for " +
+                                            name);
+            } else if (name == "--sort") {
+                if (value == "morton")
+                    opts.sort = Order::MORTON;
+                else if (value == "hilbert")
+                    opts.sort = Order::HILBERT;
+                else if (value == "none")
+                    opts.sort = Order::NONE;
+                else
+                    throw invalid_argument("bad value '" + value + "' for " +
+                                            name);
+            } else if (name == "--compress") {
+                if (value == "gzip")
+                    opts.compression = Lammps::GZIP;
+                else if (value == "none")
+                    opts.compression = Lammps::PLAIN;
+                else
+                    throw invalid_argument("bad value '" + value + "' for " +
+                                            name);
+            } else {
+                throw invalid_argument("unknown option " + name);
             }
         }
 
-        // Return results
-        if (closestCenter == regionId)
-            return true;
-        else {
-            return false;
+        if (opts.formatThreads == 0)
+            opts.formatThreads = max(1, opts.threads/4);
+
+        return opts;
+    }
+
+    bool isBinaryName(const string &fname) {
+        /* Whether a file name asks for the binary format (see Binary.h) */
+
+        const string ext = ".pv3d";
+
+        return fname.size() > ext.size() &&
+                fname.compare(fname.size() - ext.size(), ext.size(), ext) == 0;
+    }
+
+    void Output::open(string fname, const Tools::Box &box,
+                        const Options &opts, int threads) {
+        /* Opens a data file, or a binary file if the name ends in .pv3d.
+         * The binary format has no room for the per-atom comments of the
+         * text writer, so any set are dropped with a warning.
+         *
+         * Throws:
+         *  runtime_error if the file cannot be created
+         */
+
+        binary = isBinaryName(fname);
+
+        if (binary && text.comment) {
+            cerr << "pv3d: " << fname << ": the binary format has no "
+                    "per-atom comments; ignoring " << text.commentName << endl;
+            text.comment = nullptr;
         }
+
+        if (binary)
+            bin.open(fname, box);
+        else
+            text.open(fname, box, opts.precision, threads, opts.compression);
     }
 
-    vector<dvec_t> genCenters(int nCenters, dvec_t boxDims) {
-        /* Randomly generates 'nCenters' number of points within 'boxDims'.
+    void Output::write(const AtomView &arr) {
+        if (binary)
+            bin.write(arr);
+        else
+            text.write(arr);
+    }
+
+    void Output::close() {
+        if (binary)
+            bin.close();
+        else
+            text.close();
+    }
+
+    void boundaryComment(Lammps::Writer &writer, const Options &opts,
+                            const vector<Voronoi::Cell> &cells,
+                            const Tools::Box &box) {
+        /* Sets the per-atom comment asked for by --gb-distance or --gb-tag,
+         * worked out from the cells as each block is formatted; clears it
+         * otherwise. 'cells' and 'box' must outlive the writing. */
+
+        writer.comment = nullptr;
+
+        if (opts.gbTag > 0) {
+            writer.comment = [&](const AtomView &arr, double *out) {
+                Boundary::tags(arr, cells, box, opts.gbTag, out);
+            };
+            writer.commentName = "1 within " + to_string(opts.gbTag) +
+                                " of a grain boundary, else 0";
+            writer.commentDigits = 0;
+        } else if (opts.gbDistance) {
+            writer.comment = [&](const AtomView &arr, double *out) {
+                Boundary::distances(arr, cells, box, out);
+            };
+            writer.commentName = "distance to the grain boundary";
+            writer.commentDigits = opts.precision;
+        }
+    }
+
+    bool collects(const Options &opts) {
+        /* Whether every atom must be held before writing */
+
+        return opts.sort != Order::NONE || opts.overlap > 0;
+    }
+
+    Overlap::Report writeCollected(Atoms &all, const Tools::Box &box,
+                                    const Options &opts, int threads,
+                                    Output &file) {
+        /* Removes close pairs and sorts the atoms, as the options ask, then
+         * writes them
+         *
+         * Returns:
+         *  report      -   close pairs removed; empty without --overlap
+         */
+
+        Overlap::Report overlaps = Overlap::Report();
+
+        if (opts.overlap > 0) {
+            overlaps = Overlap::removeClose(all, box, opts.overlap,
+                                            opts.overlapPolicy, threads);
+        }
+
+        Order::sort(all, box, opts.sort, threads);
+        file.write(all.view());
+
+        return overlaps;
+    }
+
+    size_t writeModel(Polycrystal::Model &model, const Options &opts,
+                        string fname, Output &file, Atoms &all) {
+        /* Writes a generated model the way main() writes a structure
          *
          * Args:
-         *  nCenters    -   the number of points to generate
-         *  boxDims     -   xyz bounds of box (assumes origin as lower bound)
+         *  model       -   the structure
+         *  opts        -   command line options
+         *  fname       -   output file
+         *  file        -   output and buffer for all atoms, reused from
+         *  all             realization to realization
          *
          * Returns:
-         *  centers     -   a set of xyz coordinates (no atom info)
+         *  n           -   number of atoms written
+         *
+         * Throws:
+         *  runtime_error if the file cannot be written
          */
 
-        vector<dvec_t> centers;
+        boundaryComment(file.text, opts, model.cells, model.box);
+        file.open(fname, model.box, opts, model.threads);
 
-        srand(time(NULL));
+        size_t n = model.size();
 
-        for (int i=0; i<nCenters; i++) {
-            dvec_t temp;
-            temp.reserve(3);
-
-            for (int j=0; j<3; j++) {
-                double rnd;
-                
-                rnd = static_cast<double>(rand()) / RAND_MAX;
-                rnd *= boxDims[j];
-                temp.push_back(rnd);
-            }
+        if (collects(opts)) {
+            all.clear();
+            all.reserve(n);
 
-            centers.push_back(temp);
+            for (size_t g=0; g<model.grains.size(); g++)
+                all.append(model.grains[g].view());
+
+            writeCollected(all, model.box, opts, model.threads, file);
+            n = all.size();
+        } else {
+            for (size_t g=0; g<model.grains.size(); g++)
+                file.write(model.grains[g].view());
         }
 
-        return centers;
+        file.close();
+
+        return n;
+    }
+
+    int runBatch(const Options &opts) {
+        /* Generates every realization of --batch and --job. Each one is
+         * the structure a single run with its box, lattice constant,
+         * grain count and seed would write. Realizations are spread over
+         * --concurrent workers; each worker keeps its model, writers and
+         * buffers from one realization to the next, so once they have
+         * grown to the largest realization nothing is reallocated.
+         *
+         * Args:
+         *  opts        -   command line options
+         *
+         * Returns:
+         *  status      -   exit status: 1 if any realization failed
+         */
+
+        vector<Batch::Job> jobs;
+
+        try {
+            if (!opts.batchFile.empty())
+                jobs = Batch::read(opts.batchFile);
+
+            for (size_t j=0; j<opts.jobs.size(); j++)
+                Batch::parse(opts.jobs[j], jobs);
+
+            Batch::check(jobs);
+        } catch (const exception &e) {
+            cerr << "pv3d: " << e.what() << endl;
+            return 1;
+        }
+
+        int nJobs = static_cast<int>(jobs.size());
+        int workers = max(1, min(opts.concurrent, nJobs));
+        int threads = max(1, opts.threads/workers);
+
+        vector<Polycrystal::Model> models(workers);
+        vector<Output> files(workers);
+        vector<Atoms> all(workers);
+
+        mutex printLock;
+        atomic<int> failed(0);
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        Parallel::forEach(nJobs, workers, [&](int j, int w) {
+            const Batch::Job &job = jobs[j];
+            chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+            size_t n = 0;
+
+            try {
+                Tools::Vec3 len = {job.side, job.side, job.side};
+                vector<Tools::Vec3> centers = genCenters(job.grains, len,
+                                                            job.seed);
+                vector<Tools::Mat3> rotations(job.grains);
+
+                for (int g=0; g<job.grains; g++) {
+                    Random::Stream s = Random::stream(job.seed, g,
+                                                        Random::ORIENTATION);
+                    rotations[g] = Random::orientation(s);
+                }
+
+                models[w].build(centers, rotations, len,
+                                Polycrystal::lattice<Structure>(job.latConst,
+                                                                TYPES),
+                                threads);
+
+                n = writeModel(models[w], opts, job.output, files[w],
+                                all[w]);
+            } catch (const exception &e) {
+                lock_guard<mutex> guard(printLock);
+                cerr << "pv3d: " << job.output << ": " << e.what() << endl;
+                failed++;
+                return;
+            }
+
+            chrono::duration<double> took = chrono::steady_clock::now() - t0;
+
+            lock_guard<mutex> guard(printLock);
+            cout << job.output << ": " << n << " atoms, " << job.grains
+                    << " grains, seed " << job.seed << ", " << took.count()
+                    << " s" << endl;
+        });
+
+        chrono::duration<double> wall = chrono::steady_clock::now() - start;
+
+        cout << "Batch: " << nJobs - failed << " of " << nJobs
+                << " realizations in " << wall.count() << " seconds (wall), "
+                << workers << " at a time, " << threads << " threads each"
+                << endl;
+
+        return failed ? 1 : 0;
     }
 
-    vector<dvec_t> genImages(vector<dvec_t> originals, dvec_t boxDims) {
-        /* Produce the 26 additional images (in 3D) of a set of
-         * points
+    int runRegrain(const Options &opts) {
+        /* Reads an existing structure, assigns every atom to the grain of
+         * its nearest center and writes it out. Data files carry no
+         * grains, so in a data file the grain id follows each atom as a
+         * "# grain" comment, which read_data skips (unless --retype
+         * already puts it in the type); a binary file keeps it with each
+         * atom. Binary output is grouped by grain so
+         * its index has one run per grain. Atom ids are renumbered in
+         * output order and charges are dropped.
          *
          * Args:
-         *  originals   -   the data points to be duplicated; assumes fractional
-         *                  coordinates
-         *  boxDims     -   dimensions of box in xyz directions
+         *  opts        -   command line options
          *
          * Returns:
-         *  images      -   the full copy of all 26 duplicated images and the
-         *                  original 1 set of points
+         *  status      -   exit status
          */
 
-        vector<dvec_t> images;
-        dvec_t toAdd;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        const string &out = opts.regrainTo;
+
+        Atoms atoms;
+        Tools::Box box;
+        vector<Tools::Vec3> centers;
+        size_t removed = 0;
+
+        try {
+            if (opts.centersFile.empty() && opts.grains == 0)
+                throw invalid_argument("--regrain needs --centers or "
+                                        "--grains");
+
+            if (Binary::isBinary(opts.regrainFrom)) {
+                Binary::File file;
+                file.open(opts.regrainFrom);
+                box = file.box();
+                atoms = file.atoms();
+            } else {
+                Lammps::Data data;
+                Lammps::readData(opts.regrainFrom, data, opts.threads);
+                box = data.box;
+                atoms = move(data.atoms);
+            }
+
+            if (!opts.centersFile.empty())
+                centers = Regrain::readCenters(opts.centersFile);
+            else
+                centers = Regrain::randomCenters(opts.grains, box, opts.seed);
+
+            Regrain::assign(atoms.view(), centers, box, opts.threads);
+
+            if (!opts.keepGrains.empty())
+                removed = Regrain::keep(atoms, opts.keepGrains);
+
+            if (opts.retype)
+                Regrain::retype(atoms.view());
+
+            Output file;
 
-        for (vector<dvec_t>::size_type a=0; a<originals.size(); a++) {
-            toAdd = originals[a];
+            if (!opts.retype && !isBinaryName(out)) {
+                file.text.comment = [](const AtomView &arr, double *value) {
+                    for (size_t a=0; a<arr.size(); a++)
+                        value[a] = arr.grain[a];
+                };
+                file.text.commentName = "grain id";
+                file.text.commentDigits = 0;
+            }
+
+            file.open(out, box, opts, opts.threads);
+
+            if (file.binary) {
+                // Counting sort by grain, keeping the order within a grain
+                vector<size_t> first(centers.size() + 1, 0);
+
+                for (size_t a=0; a<atoms.size(); a++)
+                    first[atoms.grain[a] + 1]++;
 
-            for (double i=-1; i<2; i++) {
-                for (double j=-1; j<2; j++) {
-                    for (double k=-1; k<2; k++) {
-                        dvec_t shift = {i*boxDims[0],j*boxDims[1],k*boxDims[2]};
-                        dvec_t temp = toAdd;
-                        Tools::addVectors(temp, shift);
+                for (size_t g=0; g<centers.size(); g++)
+                    first[g+1] += first[g];
 
-                        images.push_back(temp);
-                    }
+                Atoms grouped;
+                grouped.resize(atoms.size());
+
+                for (size_t a=0; a<atoms.size(); a++) {
+                    size_t to = first[atoms.grain[a]]++;
+                    grouped.x[to] = atoms.x[a];
+                    grouped.y[to] = atoms.y[a];
+                    grouped.z[to] = atoms.z[a];
+                    grouped.type[to] = atoms.type[a];
+                    grouped.grain[to] = atoms.grain[a];
                 }
+
+                file.write(grouped.view());
+            } else {
+                file.write(atoms.view());
             }
+
+            file.close();
+        } catch (const exception &e) {
+            cerr << "pv3d: " << e.what() << endl;
+            return 1;
         }
-        return images;
+
+        chrono::duration<double> wall = chrono::steady_clock::now() - start;
+
+        cout << "Regrain: " << atoms.size() << " atoms written into "
+                << centers.size() << " grains, " << removed
+                << " removed, " << wall.count() << " seconds (wall), "
+                << opts.threads << " threads" << endl;
+
+        return 0;
     }
 }
 
-int main() {
+int main(int argc, char *argv[]) {
 
     clock_t t1 = clock();
-   
-    // TODO: genImages needs to shift by boxDims; make adaptable to rectangles
-    double sideLength;
+    chrono::steady_clock::time_point wall1 = chrono::steady_clock::now();
+
+    Pv3d::Options opts;
+
+    try {
+        opts = Pv3d::parseArgs(argc, argv);
+    } catch (const invalid_argument &e) {
+        cerr << "pv3d: " << e.what() << endl;
+        cerr << "Usage: pv3d [--threads N] [--tiles N] [--seed N] "
+                "[--precision N] [--pipeline] [--format-threads N] "
+                "[--compress gzip|none] [--sort morton|hilbert|none] "
+                "[--overlap R] [--overlap-policy first|lower|higher] "
+                "[--gb-distance] [--gb-tag D] [--batch FILE] [--job LINE] "
+                "[--concurrent K] [--regrain IN OUT] [--centers FILE] "
+                "[--grains N] [--keep LIST] [--retype] [--convert IN OUT]"
+                << endl;
+        return 1;
+    }
+
+    if (!opts.convertFrom.empty()) {
+        try {
+            if (Binary::isBinary(opts.convertFrom))
+                Binary::toLammps(opts.convertFrom, opts.convertTo,
+                                    opts.precision, opts.threads);
+            else
+                Binary::fromLammps(opts.convertFrom, opts.convertTo,
+                                    opts.threads);
+        } catch (const runtime_error &e) {
+            cerr << "pv3d: " << e.what() << endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    if (!opts.regrainFrom.empty())
+        return Pv3d::runRegrain(opts);
+
+    if (!opts.batchFile.empty() || !opts.jobs.empty())
+        return Pv3d::runBatch(opts);
+
+    int numThreads = opts.threads;
+
+    double sideLength = 0;
 
     cout << "Box side length: ";
     cin >> sideLength;
 
-    dvec_t boxDims = {sideLength,sideLength,sideLength};
-    vector<dvec_t> boxMinMax;
+    // Overlap::removeClose would only refuse it after generating
+    if (opts.overlap > 0 && sideLength > 0 && 2*opts.overlap >= sideLength) {
+        cerr << "pv3d: --overlap " << opts.overlap << " must be below half "
+                "the side length" << endl;
+        return 1;
+    }
 
-    boxMinMax.push_back(dvec_t {0, sideLength});
-    boxMinMax.push_back(dvec_t {0, sideLength});
-    boxMinMax.push_back(dvec_t {0, sideLength});
+    Tools::Vec3 boxDims = {sideLength,sideLength,sideLength};
 
-    double latConst;
-    int numGrains;
+    double latConst = 0;
+    int numGrains = 0;
     string fname;
 
     cout << "Lattice constant: ";
@@ -187,71 +791,236 @@ int main() {
     cout << "Output file name: ";
     cin >> fname;
 
-    vector<dvec_t> centers = Pv3d::genCenters(numGrains, boxDims);
-    
-    vector<dvec_t> basis;
-    vector<dvec_t> basis2;
-    basis.reserve(8);
-    basis2.reserve(8);
+    // Same rules as a batch job line (see Batch::parse)
+    if (!cin || !(sideLength > 0) || !(latConst > 0) ||
+            latConst > sideLength || numGrains <= 0) {
+        cerr << "pv3d: need a side length > 0, a lattice constant in "
+                "(0, side] and at least one grain" << endl;
+        return 1;
+    }
+
+    vector<Tools::Vec3> centers = Pv3d::genCenters(numGrains, boxDims,
+                                                    opts.seed);
 
-    basis.push_back(dvec_t {0,0,0});
-    basis.push_back(dvec_t {0.5,0.5,0});
-    basis.push_back(dvec_t {0,0.5,0.5});
-    basis.push_back(dvec_t {0.5,0,0.5});
 
-    basis2.push_back(dvec_t {0.5,0.5,0.5});
-    basis2.push_back(dvec_t {0,0,0.5});
-    basis2.push_back(dvec_t {0,0.5,0});
-    basis2.push_back(dvec_t {0.5,0,0});
+    Tools::Box box = {Tools::Vec3 {0,0,0}, boxDims, 0, 0, 0};
 
-    vector<dvec_t> fullCrystal;
-    dvec_t center;
+    // Periodic lookup of the owning grain through the minimum image
+    // convention; no images are built. With few grains a vectorized scan
+    // over the centers is fastest; beyond that use the bucket grid.
+    const int maxScanGrains = 32;
+    bool useScan = numGrains <= maxScanGrains;
 
-    vector<dvec_t> images = Pv3d::genImages(centers, boxDims);
+    CenterGrid grid;
+    Classify::Centers packed;
 
-    // Iterate over each family of regions
-    for (int j=0; j<numGrains; j++) {
+    grid.build(centers, boxDims);
 
-        double theta = rand()*2*M_PI / RAND_MAX;
-        double x = static_cast<double>(rand()) / RAND_MAX;
-        double y = static_cast<double>(rand()) / RAND_MAX;
-        double z = static_cast<double>(rand()) / RAND_MAX;
-        dvec_t axis = {x,y,z};
+    if (useScan)
+        packed = Classify::pack(centers, box);
 
-        // Iterate over all 27 images
-        for (int i=j*27; i<(j+1)*27; i++) {
+    // Each grain is generated only inside its own polyhedron
+    vector<Voronoi::Cell> cells(numGrains);
 
-            center = images[i];
-            j = static_cast<int>(floor(i/27)); // images are in blocks of 27
+    vector<Tools::Mat3> rotations(numGrains);
 
+    // Orientations come from per-grain streams, so they do not depend on
+    // the order grains are visited in
+    Parallel::forEach(numGrains, numThreads, [&](int j, int) {
+        cells[j] = Voronoi::computeCell(centers, grid, j);
 
-            // Here grain1/2 represent the 'grains' of the 1st and 2nd basis
-            // For more/less bases, delete grain2 or add grain3, grain4, ...
-            vector<dvec_t> grain1;
-            vector<dvec_t> grain2;
+        Random::Stream s = Random::stream(opts.seed, j, Random::ORIENTATION);
+        rotations[j] = Random::orientation(s);
+    });
 
-            // 1.0 and 2.0 should correspond to grain1 grain2
-            grain1 = Grain::genGrain(boxDims, basis, latConst, 1.0);
-            grain2 = Grain::genGrain(boxDims, basis2, latConst, 2.0);
-            grain1 = Tools::joinArrays(grain1, grain2);
+    // Work space is per thread and reused from grain to grain
+    vector<Grain::Scratch> scratch(numThreads);
 
-            Tools::rotate(grain1,theta,axis);
+    // Fills grain j, or the part of it in 'clip', on thread t
+    auto fillGrain = [&](Atoms &out, int j, int t, const Tools::Box *clip) {
+        Atoms &edge = scratch[t].edge;
+        vector<int> &owner = scratch[t].owner;
 
-            Grain::shiftGrain(grain1, center);
+        edge.clear();
 
-            for (vector<dvec_t>::size_type a=0; a<grain1.size(); a++) {
-                if (Pv3d::inBox(grain1[a], boxMinMax) &&
-                        Pv3d::inRegion(grain1[a], images, j)) {
-                    fullCrystal.push_back(grain1[a]);
-                }
+        // All sublattices in one pass
+        Grain::genGrainInCell<Structure>(out, edge, cells[j], latConst,
+                                            TYPES, rotations[j], box, clip,
+                                            &scratch[t]);
+
+        // Only sites on the cell boundary need the classifier
+        AtomView e = edge.view();
+        owner.resize(e.size());
+
+        if (useScan)
+            Classify::nearest(e, packed, owner.data(), j);
+        else
+            Classify::nearest(e, grid, owner.data());
+
+        Grain::keepOwnCell(edge, owner, j, centers[j], box);
+
+        out.append(edge.view());
+    };
+
+    // Chunks (grains or tiles) go to the file as soon as every chunk
+    // before them is done, so only chunks finished out of order are held
+    // in memory. Names ending in .pv3d get the binary format, which has
+    // nothing to format, so it is never pipelined; nor are sorting and
+    // overlap removal, which collect every atom before writing.
+    bool collect = Pv3d::collects(opts);
+    bool pipelined = opts.pipeline && !Pv3d::isBinaryName(fname) &&
+                        !collect;
+
+    Pv3d::Output file;
+    Pv3d::boundaryComment(file.text, opts, cells, box);
+
+    // Tiles of equal volume, each filled with the pieces of the grains
+    // crossing it, or else every grain on its own
+    Tiles::Layout layout;
+    int numChunks = numGrains;
+
+    if (opts.tiles > 0) {
+        layout = Tiles::build(cells, boxDims, opts.tiles);
+        numChunks = layout.count();
+    }
+
+    auto fillChunk = [&](int c, int t, Atoms &out) {
+        if (opts.tiles > 0) {
+            const vector<Tiles::Piece> &pieces = layout.pieces[c];
+
+            // Sized once from the tile volume instead of growing
+            out.reserve(Grain::expectedSites<Structure>(
+                    layout.width.x*layout.width.y*layout.width.z,
+                    latConst)*11/10 + 64);
+
+            for (size_t p=0; p<pieces.size(); p++) {
+                Tools::Box region = layout.region(c, pieces[p].shift);
+                fillGrain(out, pieces[p].grain, t, &region);
             }
+        } else {
+            // Sized once from the cell volume instead of growing
+            out.reserve(Grain::expectedSites<Structure>(
+                    cells[c].volume, latConst)*11/10 + 64);
+
+            fillGrain(out, c, t, nullptr);
+        }
+    };
+
+    Parallel::Stats stats;
+    Pipeline::Report stages;
+    Overlap::Report overlaps;
+    Memory::Usage genStart = Memory::usage();
+
+    // A worker's exception is rethrown here, as is a failed write (a full
+    // disk, say); either leaves the file incomplete
+    try {
+        file.open(fname, box, opts, numThreads);
+
+        if (pipelined) {
+            // Generators may run two chunks per thread ahead of the writer
+            stages = Pipeline::run(numChunks, numThreads, opts.formatThreads,
+                                    2*numThreads, fillChunk, file.text);
+        } else {
+            vector<Atoms> chunks(numChunks);
+            Parallel::InOrder output;
+            Atoms all;
+
+            output.reset(numChunks, [&](int c) {
+                if (collect)
+                    all.append(chunks[c].view());
+                else
+                    file.write(chunks[c].view());
+
+                chunks[c] = Atoms();
+            });
+
+            auto body = [&](int c, int t) {
+                fillChunk(c, t, chunks[c]);
+                output.done(c);
+            };
+
+            // Stealing keeps threads busy when tiles are uneven
+            if (opts.tiles > 0)
+                Parallel::forEachStealing(numChunks, numThreads, body,
+                                            &stats);
+            else
+                Parallel::forEach(numChunks, numThreads, body, &stats);
+
+            if (collect)
+                overlaps = Pv3d::writeCollected(all, box, opts, numThreads,
+                                                file);
         }
+
+        file.close();
+    } catch (const exception &e) {
+        cerr << "pv3d: " << e.what() << endl;
+        return 1;
     }
 
-    Lammps::writeData(fname, fullCrystal);
+    Memory::Usage genEnd = Memory::usage();
 
     clock_t t2 = clock();
     float diff = static_cast<float>(t2)-static_cast<float>(t1);
 
-    cout << "Runtime: " << diff/CLOCKS_PER_SEC << " seconds"<< endl;
+    chrono::duration<double> wall = chrono::steady_clock::now() - wall1;
+
+    cout << "Runtime: " << wall.count() << " seconds (wall), "
+            << diff/CLOCKS_PER_SEC << " seconds (CPU), " << numThreads
+            << " threads" << endl;
+    cout << "Seed: " << opts.seed << endl;
+
+    if (pipelined) {
+        const Pipeline::Stage *stage[3] = {&stages.generate, &stages.format,
+                                            &stages.write};
+        const char *names[3] = {"generate", "format", "write"};
+
+        for (int s=0; s<3; s++) {
+            cout << "Stage " << names[s] << ": " << stage[s]->busy
+                    << " s busy, " << stage[s]->waiting << " s waiting, "
+                    << stage[s]->threads << " threads" << endl;
+        }
+
+        cout << "Queues (window " << stages.window << " chunks): format "
+                << stages.formatQueueMean << " mean, "
+                << stages.formatQueueMax << " max; write "
+                << stages.writeQueueMean << " mean, "
+                << stages.writeQueueMax << " max; bottleneck: "
+                << stages.bottleneck() << endl;
+    } else {
+        cout << "Load balance: busiest thread " << stats.imbalance()
+                << "x the mean, " << stats.steals << " items stolen" << endl;
+    }
+
+    if (opts.overlap > 0) {
+        cout << "Overlaps: " << overlaps.pairs << " pairs closer than "
+                << opts.overlap << ", " << overlaps.removed
+                << " atoms removed" << endl;
+
+        // Grain pairs that lost the most atoms
+        vector<pair<size_t, pair<int, int> > > worst;
+        map<pair<int, int>, Overlap::Count>::const_iterator g;
+
+        for (g=overlaps.grains.begin(); g!=overlaps.grains.end(); g++)
+            worst.push_back(make_pair(g->second.removed, g->first));
+
+        sort(worst.rbegin(), worst.rend());
+
+        for (size_t w=0; w<min(worst.size(), static_cast<size_t>(10)); w++) {
+            const pair<int, int> &key = worst[w].second;
+
+            cout << "  grains " << key.first << "-" << key.second << ": "
+                    << overlaps.grains[key].pairs << " pairs, "
+                    << overlaps.grains[key].removed << " removed" << endl;
+        }
+
+        if (worst.size() > 10)
+            cout << "  (" << worst.size() - 10 << " more grain pairs)" << endl;
+    }
+
+    Memory::Usage mem = Memory::usage();
+
+    cout << "Memory: peak RSS " << mem.peakRss/1024.0 << " MB, "
+            << mem.allocations << " allocations ("
+            << genEnd.allocations - genStart.allocations
+            << " while generating and writing)" << endl;
 }
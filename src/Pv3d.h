@@ -2,15 +2,82 @@
 #define PV3D_H
 
 #include <vector>
+#include <string>
+#include <cstdint>
 #include "define.h"
+#include "Tools.h"
+#include "Atoms.h"
+#include "Lammps.h"
+#include "Order.h"
+#include "Overlap.h"
+#include "Voronoi.h"
+#include "Binary.h"
+#include "Polycrystal.h"
 
 namespace Pv3d {
 
-    bool inRegion(dvec_t, vector<dvec_t> int);
+    // Command line options
+    struct Options {
+        int threads;
+        int tiles;                  // tiles per axis; 0 to work by grain
+        uint64_t seed;
+        int precision;              // digits after the decimal point
+        bool pipeline;              // separate generate/format/write stages
+        int formatThreads;          // formatting threads when pipelined
+        Lammps::Compression compression;
+        Order::Curve sort;          // order of the atoms in the output
+        double overlap;             // closest distance allowed; 0 for any
+        Overlap::Policy overlapPolicy;
+        bool gbDistance;            // write the distance to the boundary
+        double gbTag;               // or tag atoms this close to it; 0: no
+        string convertFrom;         // files to convert instead of
+        string convertTo;           // generating, if given
+        string batchFile;           // batch job file, if given
+        vector<string> jobs;        // batch job lines from the command line
+        int concurrent;             // realizations of a batch at once
+        string regrainFrom;         // structure to re-grain and where to
+        string regrainTo;           // write it, if given
+        string centersFile;         // centers to re-grain with, or
+        int grains;                 // this many random ones
+        vector<int> keepGrains;     // grains kept when re-graining; all if
+                                    // empty
+        bool retype;                // type = grain id + 1 when re-graining
+    };
 
-    vector<dvec_t> genCenters(int, dvec_t);
+    Options parseArgs(int, char**);
 
-    vector<dvec_t> genImages(vector<dvec_t>, dvec_t);
+    int runBatch(const Options&);
+
+    int runRegrain(const Options&);
+
+    // Output file of a run: a LAMMPS data file, or the binary format for
+    // names ending in .pv3d
+    struct Output {
+        bool binary;
+        Lammps::Writer text;
+        Binary::Writer bin;
+
+        void open(string, const Tools::Box&, const Options&, int);
+
+        void write(const AtomView&);
+
+        void close();
+    };
+
+    bool isBinaryName(const string&);
+
+    void boundaryComment(Lammps::Writer&, const Options&,
+                            const vector<Voronoi::Cell>&, const Tools::Box&);
+
+    bool collects(const Options&);
+
+    Overlap::Report writeCollected(Atoms&, const Tools::Box&, const Options&,
+                                    int, Output&);
+
+    size_t writeModel(Polycrystal::Model&, const Options&, string, Output&,
+                        Atoms&);
+
+    vector<Tools::Vec3> genCenters(int, Tools::Vec3, uint64_t);
 }
 
 #endif
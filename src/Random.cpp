@@ -0,0 +1,130 @@
+/* Counter-based random number generation for reproducible, parallel draws.
+ *
+ * Author: Josh Vita
+ * Created: 2017/7
+ * Last edited: 2017/7
+ */
+
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include "Tools.h"
+#include "Random.h"
+
+using namespace std;
+
+namespace {
+
+    // Philox4x32 multipliers and Weyl key increments (Salmon et al., 2011)
+    const uint32_t M0 = 0xD2511F53;
+    const uint32_t M1 = 0xCD9E8D57;
+    const uint32_t W0 = 0x9E3779B9;
+    const uint32_t W1 = 0xBB67AE85;
+
+    const int ROUNDS = 10;
+}
+
+namespace Random {
+
+    Block philox(Block ctr, uint64_t seed) {
+        /* Philox4x32-10 block function
+         *
+         * Args:
+         *  ctr     -   128-bit counter
+         *  seed    -   64-bit key; low word first
+         *
+         * Returns:
+         *  128 random bits
+         */
+
+        uint32_t k0 = static_cast<uint32_t>(seed);
+        uint32_t k1 = static_cast<uint32_t>(seed >> 32);
+
+        for (int r=0; r<ROUNDS; r++) {
+            uint64_t p0 = static_cast<uint64_t>(M0)*ctr[0];
+            uint64_t p1 = static_cast<uint64_t>(M1)*ctr[2];
+
+            ctr = Block {{static_cast<uint32_t>(p1 >> 32) ^ ctr[1] ^ k0,
+                            static_cast<uint32_t>(p1),
+                            static_cast<uint32_t>(p0 >> 32) ^ ctr[3] ^ k1,
+                            static_cast<uint32_t>(p0)}};
+
+            k0 += W0;
+            k1 += W1;
+        }
+
+        return ctr;
+    }
+
+    uint64_t Stream::next64() {
+        /* Next 64 random bits of the sequence */
+
+        if (used >= 4) {
+            block = philox(Block {{static_cast<uint32_t>(counter),
+                                    static_cast<uint32_t>(counter >> 32),
+                                    grain, id}}, seed);
+            counter++;
+            used = 0;
+        }
+
+        uint64_t bits = (static_cast<uint64_t>(block[used]) << 32) |
+                        block[used+1];
+        used += 2;
+
+        return bits;
+    }
+
+    double Stream::uniform() {
+        /* Uniform double in [0,1) with 53 random bits */
+
+        return (next64() >> 11) * (1.0/9007199254740992.0);
+    }
+
+    Stream stream(uint64_t seed, int grain, int id) {
+        /* Starts the sequence of draws for one grain and stream
+         *
+         * Args:
+         *  seed    -   run seed
+         *  grain   -   grain id
+         *  id      -   stream id (see StreamId)
+         */
+
+        Stream s;
+        s.seed = seed;
+        s.grain = static_cast<uint32_t>(grain);
+        s.id = static_cast<uint32_t>(id);
+        s.counter = 0;
+        s.used = 4;
+
+        return s;
+    }
+
+    Tools::Mat3 orientation(Stream &s) {
+        /* Draws a rotation uniformly distributed over SO(3), from a uniform
+         * unit quaternion (Shoemake, Graphics Gems III). Picking a random
+         * axis and a uniform angle instead over-samples small rotations.
+         *
+         * Args:
+         *  s       -   stream to draw from; uses three uniforms
+         *
+         * Returns:
+         *  rotMat  -   the rotation matrix
+         */
+
+        double u1 = s.uniform();
+        double u2 = s.uniform()*2*M_PI;
+        double u3 = s.uniform()*2*M_PI;
+
+        double a = sqrt(1-u1);
+        double b = sqrt(u1);
+
+        return Tools::quaternion(b*cos(u3), a*sin(u2), a*cos(u2), b*sin(u3));
+    }
+
+    uint64_t timeSeed() {
+        /* Seed from the clock, for runs without an explicit seed */
+
+        return static_cast<uint64_t>(
+                    chrono::system_clock::now().time_since_epoch().count());
+    }
+}
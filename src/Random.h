@@ -0,0 +1,50 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+#include <array>
+#include "Tools.h"
+
+using namespace std;
+
+/* Counter-based random numbers (Philox4x32-10). A draw is a pure function of
+ * (seed, grain, stream, index), so any thread can produce any grain's values
+ * without shared state, and a run is reproduced exactly from its seed.
+ */
+namespace Random {
+
+    typedef array<uint32_t, 4> Block;
+
+    // Independent sequences kept per grain
+    enum StreamId {
+        CENTER = 0,
+        ORIENTATION = 1,
+        DECORATION = 2
+    };
+
+    Block philox(Block, uint64_t);
+
+    /* Sequence of draws for one (seed, grain, stream). Cheap to create;
+     * holds only the position in the sequence.
+     */
+    struct Stream {
+        uint64_t seed;
+        uint32_t grain;
+        uint32_t id;
+        uint64_t counter;           // next block to generate
+        Block block;
+        int used;                   // 32-bit words of 'block' consumed
+
+        uint64_t next64();
+
+        double uniform();
+    };
+
+    Stream stream(uint64_t, int, int);
+
+    Tools::Mat3 orientation(Stream&);
+
+    uint64_t timeSeed();
+}
+
+#endif
@@ -0,0 +1,331 @@
+/* Assigning existing atoms to the grains of a set of centers.
+ *
+ * Author: Josh Vita
+ * Created: 2017/7
+ * Last edited: 2017/7
+ */
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include "Atoms.h"
+#include "Tools.h"
+#include "Grid.h"
+#include "Classify.h"
+#include "Parallel.h"
+#include "Random.h"
+#include "Regrain.h"
+
+using namespace std;
+
+namespace {
+
+    // Atoms classified per work item
+    const size_t CHUNK = 1 << 14;
+
+    // Bins per center, and atoms per bin, aimed for; finer bins leave
+    // fewer candidates per atom but cost more to set up
+    const size_t BINS_PER_CENTER = 8;
+    const size_t ATOMS_PER_BIN = 64;
+    const size_t MAX_BINS = 1 << 21;
+
+    // An image of a center that may be the nearest to some point of a bin,
+    // and its displacement from the middle of the bin
+    struct Candidate {
+        int id;
+        Tools::Vec3 d;
+    };
+
+    /* Regular bins over an orthorhombic box, each with the few center
+     * images that can own a point in it. Most bins lie inside one Voronoi
+     * cell and have a single candidate.
+     */
+    struct Bins {
+        Tools::Box box;
+        int nb[3];
+        Tools::Vec3 width;
+        vector<size_t> start;           // bin b: [start[b], start[b+1])
+        vector<Candidate> candidates;
+
+        void build(const vector<Tools::Vec3> &centers, const Tools::Box &b,
+                    size_t nAtoms, int threads) {
+            box = b;
+
+            size_t target = max(BINS_PER_CENTER*centers.size(),
+                                nAtoms/ATOMS_PER_BIN);
+            target = max<size_t>(1, min(target, MAX_BINS));
+
+            double side = cbrt(box.len.x*box.len.y*box.len.z/target);
+            const double len[3] = {box.len.x, box.len.y, box.len.z};
+
+            for (int d=0; d<3; d++)
+                nb[d] = max(1, static_cast<int>(len[d]/side));
+
+            width = Tools::Vec3 {box.len.x/nb[0], box.len.y/nb[1],
+                                    box.len.z/nb[2]};
+
+            CenterGrid grid;
+            grid.build(centers, box.len);
+
+            int nBins = nb[0]*nb[1]*nb[2];
+            vector<vector<Candidate> > lists(nBins);
+            Tools::Vec3 h = width*0.5;
+            double halfDiag = sqrt(Tools::norm2(h));
+
+            Parallel::forEach(nb[2], threads, [&](int k, int) {
+                vector<int> ids;
+                vector<Tools::Vec3> disp;
+
+                for (int j=0; j<nb[1]; j++) {
+                    for (int i=0; i<nb[0]; i++) {
+                        Tools::Vec3 mid = box.lo + Tools::Vec3 {
+                            (i+0.5)*width.x, (j+0.5)*width.y,
+                            (k+0.5)*width.z};
+
+                        // No point of the bin is further than 'reach' from
+                        // its nearest center...
+                        double best2;
+                        grid.nearest(mid, best2);
+                        double reach = sqrt(best2) + halfDiag;
+
+                        // ... so only images within reach of the bin count
+                        grid.within(mid, reach + halfDiag, ids, disp);
+
+                        double bound = reach;
+
+                        for (size_t c=0; c<ids.size(); c++) {
+                            Tools::Vec3 far = {fabs(disp[c].x) + h.x,
+                                                fabs(disp[c].y) + h.y,
+                                                fabs(disp[c].z) + h.z};
+                            bound = min(bound, sqrt(Tools::norm2(far)));
+                        }
+
+                        vector<Candidate> &list = lists[(k*nb[1] + j)*nb[0]
+                                                        + i];
+
+                        for (size_t c=0; c<ids.size(); c++) {
+                            Tools::Vec3 near = {
+                                max(0.0, fabs(disp[c].x) - h.x),
+                                max(0.0, fabs(disp[c].y) - h.y),
+                                max(0.0, fabs(disp[c].z) - h.z)};
+
+                            if (sqrt(Tools::norm2(near)) <=
+                                    bound*(1 + 1e-12))
+                                list.push_back(Candidate {ids[c], disp[c]});
+                        }
+
+                        // Ties go to the lower id, as in CenterGrid
+                        sort(list.begin(), list.end(),
+                                [](const Candidate &a, const Candidate &b) {
+                                    return a.id < b.id;
+                                });
+                    }
+                }
+            });
+
+            start.assign(nBins + 1, 0);
+
+            for (int b=0; b<nBins; b++)
+                start[b+1] = start[b] + lists[b].size();
+
+            candidates.resize(start.back());
+
+            for (int b=0; b<nBins; b++)
+                copy(lists[b].begin(), lists[b].end(),
+                        candidates.begin() + start[b]);
+        }
+
+        int nearest(Tools::Vec3 p) const {
+            /* Owner of a point anywhere, through its image in the box */
+
+            Tools::Vec3 w = Tools::wrap(p, box) - box.lo;
+
+            int i = min(static_cast<int>(w.x/width.x), nb[0]-1);
+            int j = min(static_cast<int>(w.y/width.y), nb[1]-1);
+            int k = min(static_cast<int>(w.z/width.z), nb[2]-1);
+
+            // Position relative to the middle of the bin
+            Tools::Vec3 e = {w.x - (i+0.5)*width.x, w.y - (j+0.5)*width.y,
+                                w.z - (k+0.5)*width.z};
+
+            size_t b = (k*nb[1] + j)*nb[0] + i;
+            size_t first = start[b];
+            size_t last = start[b+1];
+
+            int owner = candidates[first].id;
+            double best = Tools::norm2(candidates[first].d - e);
+
+            for (size_t c=first+1; c<last; c++) {
+                double d2 = Tools::norm2(candidates[c].d - e);
+
+                if (d2 < best) {
+                    best = d2;
+                    owner = candidates[c].id;
+                }
+            }
+
+            return owner;
+        }
+    };
+}
+
+namespace Regrain {
+
+    vector<Tools::Vec3> readCenters(string filename) {
+        /* Reads grain centers, one "x y z" per line; blank lines and text
+         * after '#' are skipped. Grain ids follow the order of the file.
+         *
+         * Throws:
+         *  runtime_error if the file cannot be read
+         *  invalid_argument for a malformed line, with its line number
+         */
+
+        ifstream in(filename.c_str());
+
+        if (!in)
+            throw runtime_error("cannot open " + filename + " for reading");
+
+        vector<Tools::Vec3> centers;
+        string line;
+
+        for (int number=1; getline(in, line); number++) {
+            istringstream words(line.substr(0, line.find('#')));
+            Tools::Vec3 c;
+            string rest;
+
+            if (!(words >> c.x)) {
+                if (words.eof())
+                    continue;
+            } else if (words >> c.y >> c.z && !(words >> rest)) {
+                centers.push_back(c);
+                continue;
+            }
+
+            throw invalid_argument(filename + ":" + to_string(number) +
+                                    ": expected 'x y z'");
+        }
+
+        return centers;
+    }
+
+    vector<Tools::Vec3> randomCenters(int n, const Tools::Box &box,
+                                        uint64_t seed) {
+        /* Uniform random centers in a box, drawn from the same per-grain
+         * streams as Pv3d::genCenters, so an orthorhombic box at the origin
+         * gets the centers a generated structure of that seed has
+         *
+         * Args:
+         *  n       -   number of centers
+         *  box     -   periodic cell (orthorhombic or triclinic)
+         *  seed    -   run seed
+         */
+
+        vector<Tools::Vec3> centers;
+        centers.reserve(n);
+
+        for (int i=0; i<n; i++) {
+            Random::Stream s = Random::stream(seed, i, Random::CENTER);
+            double u = s.uniform();
+            double v = s.uniform();
+            double w = s.uniform();
+
+            centers.push_back(box.lo + Tools::Vec3 {
+                                u*box.len.x + v*box.xy + w*box.xz,
+                                v*box.len.y + w*box.yz, w*box.len.z});
+        }
+
+        return centers;
+    }
+
+    void assign(AtomView arr, const vector<Tools::Vec3> &centers,
+                const Tools::Box &box, int threads) {
+        /* Sets the grain of every atom to its nearest center, in chunks
+         * spread over the threads. In an orthorhombic box the box is first
+         * cut into bins, each listing the center images that can own a
+         * point in it, so most atoms are settled by one or two distances
+         * whatever the number of centers. Triclinic boxes use the scan.
+         *
+         * Args:
+         *  arr     -   atoms; their grain ids are overwritten
+         *  centers -   grain centers; ids are their indices
+         *  box     -   periodic cell
+         *  threads -   threads to classify with
+         *
+         * Throws:
+         *  invalid_argument if there are no centers
+         */
+
+        if (centers.empty())
+            throw invalid_argument("no grain centers to assign atoms to");
+
+        bool triclinic = Tools::isTriclinic(box);
+
+        Bins bins;
+        Classify::Centers packed;
+
+        if (triclinic)
+            packed = Classify::pack(centers, box);
+        else
+            bins.build(centers, box, arr.size(), threads);
+
+        int nChunks = static_cast<int>((arr.size() + CHUNK - 1)/CHUNK);
+
+        Parallel::forEach(nChunks, threads, [&](int c, int) {
+            size_t first = c*CHUNK;
+            AtomView chunk = arr.slice(first, min(CHUNK,
+                                                    arr.size() - first));
+
+            if (triclinic) {
+                Classify::nearest(chunk, packed, chunk.grain);
+                return;
+            }
+
+            for (size_t a=0; a<chunk.size(); a++) {
+                chunk.grain[a] = bins.nearest(Tools::Vec3 {chunk.x[a],
+                                                chunk.y[a], chunk.z[a]});
+            }
+        });
+    }
+
+    size_t keep(Atoms &atoms, const vector<int> &grains) {
+        /* Keeps the atoms of the listed grains, in their order
+         *
+         * Returns:
+         *  removed -   number of atoms dropped
+         */
+
+        vector<int> wanted(grains);
+        sort(wanted.begin(), wanted.end());
+
+        size_t kept = 0;
+
+        for (size_t a=0; a<atoms.size(); a++) {
+            if (!binary_search(wanted.begin(), wanted.end(), atoms.grain[a]))
+                continue;
+
+            atoms.x[kept] = atoms.x[a];
+            atoms.y[kept] = atoms.y[a];
+            atoms.z[kept] = atoms.z[a];
+            atoms.type[kept] = atoms.type[a];
+            atoms.grain[kept] = atoms.grain[a];
+            kept++;
+        }
+
+        size_t removed = atoms.size() - kept;
+        atoms.resize(kept);
+
+        return removed;
+    }
+
+    void retype(AtomView arr) {
+        /* Gives every atom the type of its grain: grain id + 1 */
+
+        for (size_t a=0; a<arr.size(); a++)
+            arr.type[a] = arr.grain[a] + 1;
+    }
+}
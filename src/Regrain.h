@@ -0,0 +1,30 @@
+#ifndef REGRAIN_H
+#define REGRAIN_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "Atoms.h"
+#include "Tools.h"
+
+using namespace std;
+
+/* Grain assignment of atoms that were not generated here, such as an
+ * amorphous or relaxed configuration read back from a file: every atom
+ * goes to the grain of its nearest center, under periodic boundaries.
+ */
+namespace Regrain {
+
+    vector<Tools::Vec3> readCenters(string);
+
+    vector<Tools::Vec3> randomCenters(int, const Tools::Box&, uint64_t);
+
+    void assign(AtomView, const vector<Tools::Vec3>&, const Tools::Box&,
+                int threads=1);
+
+    size_t keep(Atoms&, const vector<int>&);
+
+    void retype(AtomView);
+}
+
+#endif
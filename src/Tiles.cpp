@@ -0,0 +1,109 @@
+/* Spatial decomposition of the box into tiles for parallel generation.
+ *
+ * Author: Josh Vita
+ * Created: 2017/7
+ * Last edited: 2017/7
+ */
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "define.h"
+#include "Tools.h"
+#include "Voronoi.h"
+#include "Tiles.h"
+
+using namespace std;
+
+namespace {
+
+    int floorDiv(int a, int n) {
+        /* Integer division rounding towards negative infinity */
+
+        return (a >= 0) ? a/n : -((-a + n - 1)/n);
+    }
+}
+
+namespace Tiles {
+
+    int Layout::count() const {
+        return nt[0]*nt[1]*nt[2];
+    }
+
+    Tools::Box Layout::region(int tile, Tools::Vec3 shift) const {
+        /* Box covered by a tile, moved by 'shift'; the tile is the
+         * half-open region [lo, lo+len) */
+
+        int i = tile % nt[0];
+        int j = (tile / nt[0]) % nt[1];
+        int k = tile / (nt[0]*nt[1]);
+
+        Tools::Vec3 lo = {i*width.x, j*width.y, k*width.z};
+
+        return Tools::Box {lo + shift, width, 0, 0, 0};
+    }
+
+    Layout build(const vector<Voronoi::Cell> &cells, Tools::Vec3 boxDims,
+                    int perAxis) {
+        /* Splits the box into perAxis^3 tiles and finds the grain pieces in
+         * each, from the bounding boxes of the cells.
+         *
+         * Args:
+         *  cells       -   Voronoi cells of all grains, in grain order
+         *  boxDims     -   xyz size of the periodic box (origin as lower
+         *                  bound)
+         *  perAxis     -   number of tiles along each axis
+         *
+         * Returns:
+         *  layout      -   tiles and the pieces overlapping each
+         */
+
+        Layout layout;
+
+        for (int d=0; d<3; d++)
+            layout.nt[d] = max(1, perAxis);
+
+        const int *nt = layout.nt;
+        layout.width = Tools::Vec3 {boxDims.x/nt[0], boxDims.y/nt[1],
+                                    boxDims.z/nt[2]};
+        layout.pieces.resize(layout.count());
+
+        const Tools::Vec3 w = layout.width;
+
+        for (size_t g=0; g<cells.size(); g++) {
+            const Tools::Vec3 lo = cells[g].lo;
+            const Tools::Vec3 hi = cells[g].hi;
+
+            int i0 = static_cast<int>(floor(lo.x/w.x));
+            int i1 = static_cast<int>(floor(hi.x/w.x));
+            int j0 = static_cast<int>(floor(lo.y/w.y));
+            int j1 = static_cast<int>(floor(hi.y/w.y));
+            int k0 = static_cast<int>(floor(lo.z/w.z));
+            int k1 = static_cast<int>(floor(hi.z/w.z));
+
+            for (int k=k0; k<=k1; k++) {
+                int qz = floorDiv(k, nt[2]);
+
+                for (int j=j0; j<=j1; j++) {
+                    int qy = floorDiv(j, nt[1]);
+
+                    for (int i=i0; i<=i1; i++) {
+                        int qx = floorDiv(i, nt[0]);
+
+                        int tile = ((k - qz*nt[2])*nt[1] + (j - qy*nt[1]))*nt[0]
+                                    + (i - qx*nt[0]);
+
+                        Piece piece;
+                        piece.grain = static_cast<int>(g);
+                        piece.shift = Tools::Vec3 {qx*boxDims.x, qy*boxDims.y,
+                                                    qz*boxDims.z};
+
+                        layout.pieces[tile].push_back(piece);
+                    }
+                }
+            }
+        }
+
+        return layout;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef TILES_H
+#define TILES_H
+
+#include <vector>
+#include "define.h"
+#include "Tools.h"
+#include "Voronoi.h"
+
+using namespace std;
+
+namespace Tiles {
+
+    // The part of a grain that falls in a tile. Cells are unwrapped around
+    // their centers, so a cell near the box edge meets the tile through a
+    // periodic image: 'shift' is the whole-box offset to move the tile by.
+    struct Piece {
+        int grain;
+        Tools::Vec3 shift;
+    };
+
+    /* Decomposition of the periodic box into equal tiles. Every tile lists
+     * the grain pieces overlapping it, in grain order, so each tile can be
+     * filled independently of the others and tiles can be merged in tile
+     * order for reproducible output.
+     */
+    struct Layout {
+        int nt[3];                          // tiles along x, y, z
+        Tools::Vec3 width;                  // tile edge lengths
+        vector<vector<Piece> > pieces;      // per tile
+
+        int count() const;
+
+        Tools::Box region(int, Tools::Vec3) const;
+    };
+
+    Layout build(const vector<Voronoi::Cell>&, Tools::Vec3, int);
+}
+
+#endif
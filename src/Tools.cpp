@@ -11,7 +11,10 @@
 #include <vector>
 #include <iostream>
 #include <cmath>
+#include <cstddef>
 #include "define.h"
+#include "Atoms.h"
+#include "Tools.h"
 
 using namespace std;
 
@@ -160,69 +163,192 @@ namespace Tools {
         cout << endl;
     }
 
-    void rotate(vector<dvec_t> &arr, double theta, dvec_t axis) {
-        /* Rotates a multidimensional array about a given axis by a given theta.
-         * Uses the Rodrigues rotation formula.
+    Mat3 rodrigues(double theta, Vec3 axis) {
+        /* Builds the 3x3 matrix for a rotation about a given axis by a given
+         * theta. Uses the Rodrigues rotation formula, R = I + sin(t)K +
+         * (1-cos(t))K^2.
          *
          * Args:
-         *  arr     - the array to be rotated (WITH atom types)
          *  theta   - angle in radians
          *  axis    - axis of rotation (will be normalized)
+         *
+         * Returns:
+         *  rotMat  - the rotation matrix
          */
 
-        double normVal = sqrt(axis[0]*axis[0] + axis[1]*axis[1] +
-                                axis[2]*axis[2]);
+        axis = axis*(1/sqrt(norm2(axis)));
 
-        scaleVector(axis, 1/normVal);
+        // Initialize the K matrix
+        Mat3 matrixK = {{Vec3 {0,-axis.z,axis.y},
+                            Vec3 {axis.z,0,-axis.x},
+                            Vec3 {-axis.y,axis.x,0}}};
 
-        int numPoints = arr.size();
+        Mat3 KK = matrixK*matrixK;
 
-        // Initialize the K matrix
-        vector<dvec_t> matrixK = {{0,-axis[2],axis[1]},
-                                            {axis[2],0,-axis[0]},
-                                            {-axis[1],axis[0],0}};
+        double s = sin(theta);
+        double c = 1-cos(theta);
 
-        vector<dvec_t> KK;
-        KK.reserve(3);
+        Mat3 rotMat;
 
-        KK = dot(matrixK, matrixK);
+        for (int i=0; i<3; i++) {
+            rotMat.r[i] = matrixK.r[i]*s + KK.r[i]*c;
+        }
 
-        vector<dvec_t> rotMat;
-        rotMat.reserve(3);
+        rotMat.r[0].x++;
+        rotMat.r[1].y++;
+        rotMat.r[2].z++;
 
-        double val;
+        return rotMat;
+    }
 
-        // Initialize the rotation matrix
-        for (int i=0; i<3; i++) {
-            dvec_t temp_v;
-            temp_v.reserve(3);
+    Mat3 quaternion(double w, double x, double y, double z) {
+        /* Builds the rotation matrix of a quaternion w + xi + yj + zk
+         *
+         * Args:
+         *  w,x,y,z - quaternion components (will be normalized)
+         *
+         * Returns:
+         *  rotMat  - the rotation matrix
+         */
 
-            for (int j=0; j<3; j++) {
-                val = matrixK[i][j]*sin(theta) + KK[i][j]*(1-cos(theta));
+        double n = 1/sqrt(w*w + x*x + y*y + z*z);
+        w *= n;
+        x *= n;
+        y *= n;
+        z *= n;
 
-                if (i==j)
-                    val++;
+        return Mat3 {{Vec3 {1-2*(y*y+z*z), 2*(x*y-w*z), 2*(x*z+w*y)},
+                        Vec3 {2*(x*y+w*z), 1-2*(x*x+z*z), 2*(y*z-w*x)},
+                        Vec3 {2*(x*z-w*y), 2*(y*z+w*x), 1-2*(x*x+y*y)}}};
+    }
 
-                temp_v.push_back(val);
-            }
-            rotMat.push_back(temp_v);
+    void applyRotation(AtomView arr, const Mat3 &rotMat) {
+        /* Rotates a block of atoms in place
+         *
+         * Args:
+         *  arr     - view of the atoms to be rotated
+         *  rotMat  - rotation matrix
+         */
+
+        const Vec3 r0 = rotMat.r[0];
+        const Vec3 r1 = rotMat.r[1];
+        const Vec3 r2 = rotMat.r[2];
+
+        double *x = arr.x;
+        double *y = arr.y;
+        double *z = arr.z;
+
+        for (size_t i=0; i<arr.size(); i++) {
+            Vec3 p = {x[i], y[i], z[i]};
+
+            x[i] = dot(r0, p);
+            y[i] = dot(r1, p);
+            z[i] = dot(r2, p);
         }
+    }
 
-        vector<dvec_t> output;
-        output.reserve(numPoints);
+    void translate(AtomView arr, Vec3 shift) {
+        /* Shifts a block of atoms in place
+         *
+         * Args:
+         *  arr     - view of the atoms to be shifted
+         *  shift   - displacement added to every atom
+         */
+
+        double *x = arr.x;
+        double *y = arr.y;
+        double *z = arr.z;
+
+        for (size_t i=0; i<arr.size(); i++) {
+            x[i] += shift.x;
+            y[i] += shift.y;
+            z[i] += shift.z;
+        }
+    }
+
+    void transform(AtomView arr, const Mat3 &rotMat, Vec3 shift) {
+        /* Rotates then shifts a block of atoms in place; one pass over memory
+         * instead of two.
+         *
+         * Args:
+         *  arr     - view of the atoms to be transformed
+         *  rotMat  - rotation matrix
+         *  shift   - displacement added after rotating
+         */
 
-        for (vector<dvec_t>::size_type i=0; i< static_cast<vector<dvec_t>::
-                size_type>(numPoints); i++) {
-            dvec_t::const_iterator first = arr[i].begin()+1;
-            dvec_t::const_iterator last = arr[i].end();
-            dvec_t temp_v (first,last);
+        const Vec3 r0 = rotMat.r[0];
+        const Vec3 r1 = rotMat.r[1];
+        const Vec3 r2 = rotMat.r[2];
 
-            temp_v = dot(rotMat, temp_v);
-            temp_v.insert(temp_v.begin(), arr[i][0]);
+        double *x = arr.x;
+        double *y = arr.y;
+        double *z = arr.z;
 
-            output.push_back(temp_v);
+        for (size_t i=0; i<arr.size(); i++) {
+            Vec3 p = {x[i], y[i], z[i]};
+
+            x[i] = dot(r0, p) + shift.x;
+            y[i] = dot(r1, p) + shift.y;
+            z[i] = dot(r2, p) + shift.z;
+        }
+    }
+
+    vector<dvec_t> rotationMatrix(double theta, dvec_t axis) {
+        /* Row-based wrapper around rodrigues() */
+
+        Mat3 rotMat = rodrigues(theta, toVec3(axis));
+
+        return vector<dvec_t> {toDvec(rotMat.r[0]), toDvec(rotMat.r[1]),
+                                toDvec(rotMat.r[2])};
+    }
+
+    void rotate(vector<dvec_t> &arr, double theta, dvec_t axis) {
+        /* Rotates a multidimensional array about a given axis by a given theta.
+         * Uses the Rodrigues rotation formula.
+         *
+         * Args:
+         *  arr     - the array to be rotated; rows are either [type,x,y,z]
+         *            (WITH atom types) or plain [x,y,z]
+         *  theta   - angle in radians
+         *  axis    - axis of rotation (will be normalized)
+         */
+
+        Mat3 rotMat = rodrigues(theta, toVec3(axis));
+
+        for (vector<dvec_t>::size_type i=0; i<arr.size(); i++) {
+            // Skip the atom type if there is one
+            dvec_t::size_type off = arr[i].size() > 3 ? 1 : 0;
+
+            Vec3 p = {arr[i][off], arr[i][off+1], arr[i][off+2]};
+            p = rotMat*p;
+
+            arr[i][off] = p.x;
+            arr[i][off+1] = p.y;
+            arr[i][off+2] = p.z;
         }
+    }
+
+    void rotate(AtomView arr, double theta, dvec_t axis) {
+        /* Rotates a block of atoms in place about a given axis by a given
+         * theta. Uses the Rodrigues rotation formula.
+         *
+         * Args:
+         *  arr     - view of the atoms to be rotated
+         *  theta   - angle in radians
+         *  axis    - axis of rotation (will be normalized)
+         */
+
+        applyRotation(arr, rodrigues(theta, toVec3(axis)));
+    }
+
+    void joinArrays(Atoms &a1, const AtomView &a2) {
+        /* Combines two arrays in place by appending 'a2' to 'a1'
+         *
+         * Args:
+         *  a1  -   first array; receives the atoms of a2
+         *  a2  -   second array
+         */
 
-        arr = output;
+        a1.append(a2);
     }
 }
@@ -2,14 +2,177 @@
 #define TOOLS_H
 
 #include <vector>
+#include <cstddef>
+#include <cmath>
 #include "define.h"
+#include "Atoms.h"
 
 using namespace std;
 
 namespace Tools {
 
+    // Fixed-size 3-vector; lives on the stack, never allocates
+    struct Vec3 {
+        double x;
+        double y;
+        double z;
+    };
+
+    // 3x3 matrix stored as rows
+    struct Mat3 {
+        Vec3 r[3];
+    };
+
+    constexpr Vec3 operator+(Vec3 a, Vec3 b) {
+        return Vec3 {a.x+b.x, a.y+b.y, a.z+b.z};
+    }
+
+    constexpr Vec3 operator-(Vec3 a, Vec3 b) {
+        return Vec3 {a.x-b.x, a.y-b.y, a.z-b.z};
+    }
+
+    constexpr Vec3 operator-(Vec3 a) {
+        return Vec3 {-a.x, -a.y, -a.z};
+    }
+
+    constexpr Vec3 operator*(Vec3 a, double s) {
+        return Vec3 {a.x*s, a.y*s, a.z*s};
+    }
+
+    constexpr Vec3 operator*(double s, Vec3 a) {
+        return a*s;
+    }
+
+    constexpr double dot(Vec3 a, Vec3 b) {
+        return a.x*b.x + a.y*b.y + a.z*b.z;
+    }
+
+    constexpr double norm2(Vec3 a) {
+        return dot(a, a);
+    }
+
+    constexpr Vec3 cross(Vec3 a, Vec3 b) {
+        return Vec3 {a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x};
+    }
+
+    constexpr Vec3 operator*(const Mat3 &m, Vec3 v) {
+        return Vec3 {dot(m.r[0], v), dot(m.r[1], v), dot(m.r[2], v)};
+    }
+
+    constexpr Vec3 column(const Mat3 &m, int j) {
+        return j == 0 ? Vec3 {m.r[0].x, m.r[1].x, m.r[2].x} :
+               j == 1 ? Vec3 {m.r[0].y, m.r[1].y, m.r[2].y} :
+                        Vec3 {m.r[0].z, m.r[1].z, m.r[2].z};
+    }
+
+    constexpr Mat3 transpose(const Mat3 &m) {
+        return Mat3 {{column(m, 0), column(m, 1), column(m, 2)}};
+    }
+
+    constexpr Mat3 operator*(const Mat3 &a, const Mat3 &b) {
+        return Mat3 {{transpose(b)*a.r[0], transpose(b)*a.r[1],
+                        transpose(b)*a.r[2]}};
+    }
+
+    constexpr Mat3 identity() {
+        return Mat3 {{Vec3 {1,0,0}, Vec3 {0,1,0}, Vec3 {0,0,1}}};
+    }
+
+    // Periodic cell in the LAMMPS convention: edge vectors a = (lx,0,0),
+    // b = (xy,ly,0) and c = (xz,yz,lz) starting from the corner 'lo'. All
+    // tilts are zero for an orthorhombic box.
+    struct Box {
+        Vec3 lo;
+        Vec3 len;
+        double xy;
+        double xz;
+        double yz;
+    };
+
+    constexpr bool isTriclinic(const Box &b) {
+        return b.xy != 0 || b.xz != 0 || b.yz != 0;
+    }
+
+    inline Vec3 minImage(Vec3 d, const Box &b) {
+        /* Shortest periodic image of the displacement 'd'. Components end up
+         * in [-len/2, len/2), so exactly one image of a point is accepted.
+         * For triclinic boxes this is the LAMMPS reduction (c, then b, then
+         * a); with strongly tilted cells a slightly shorter image can exist.
+         */
+
+        double n = floor(d.z/b.len.z + 0.5);
+        d.z -= n*b.len.z;
+        d.y -= n*b.yz;
+        d.x -= n*b.xz;
+
+        n = floor(d.y/b.len.y + 0.5);
+        d.y -= n*b.len.y;
+        d.x -= n*b.xy;
+
+        n = floor(d.x/b.len.x + 0.5);
+        d.x -= n*b.len.x;
+
+        return d;
+    }
+
+    inline Vec3 wrap(Vec3 p, const Box &b) {
+        /* Maps 'p' back into the periodic cell */
+
+        Vec3 d = p - b.lo;
+
+        if (!isTriclinic(b)) {
+            d.x -= b.len.x*floor(d.x/b.len.x);
+            d.y -= b.len.y*floor(d.y/b.len.y);
+            d.z -= b.len.z*floor(d.z/b.len.z);
+
+            // Rounding can land exactly on the upper face
+            if (d.x >= b.len.x) d.x = 0;
+            if (d.y >= b.len.y) d.y = 0;
+            if (d.z >= b.len.z) d.z = 0;
+
+            return b.lo + d;
+        }
+
+        // Fractional coordinates along c, b, a
+        double fc = d.z/b.len.z;
+        double fb = (d.y - fc*b.yz)/b.len.y;
+        double fa = (d.x - fb*b.xy - fc*b.xz)/b.len.x;
+
+        fc -= floor(fc);
+        fb -= floor(fb);
+        fa -= floor(fa);
+
+        // Rounding can land exactly on the upper face
+        if (fa >= 1) fa = 0;
+        if (fb >= 1) fb = 0;
+        if (fc >= 1) fc = 0;
+
+        return b.lo + Vec3 {fa*b.len.x + fb*b.xy + fc*b.xz,
+                            fb*b.len.y + fc*b.yz, fc*b.len.z};
+    }
+
+    inline Vec3 toVec3(const dvec_t &v) {
+        return Vec3 {v[0], v[1], v[2]};
+    }
+
+    inline dvec_t toDvec(Vec3 v) {
+        return dvec_t {v.x, v.y, v.z};
+    }
+
+    Mat3 rodrigues(double, Vec3);
+
+    Mat3 quaternion(double, double, double, double);
+
+    void applyRotation(AtomView, const Mat3&);
+
+    void translate(AtomView, Vec3);
+
+    void transform(AtomView, const Mat3&, Vec3);
+
     vector<dvec_t> joinArrays(vector<dvec_t>, vector<dvec_t>);
 
+    void joinArrays(Atoms&, const AtomView&);
+
     void addVectors(dvec_t&, dvec_t&);
 
     void scaleVector(dvec_t&, double);
@@ -22,6 +185,10 @@ namespace Tools {
 
     void printArr(dvec_t);
 
+    vector<dvec_t> rotationMatrix(double, dvec_t);
+
     void rotate(vector<dvec_t>&, double, dvec_t);
+
+    void rotate(AtomView, double, dvec_t);
 }
 #endif
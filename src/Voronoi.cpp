@@ -0,0 +1,420 @@
+/* Periodic Voronoi polyhedra built by clipping a box with the bisecting
+ * planes of neighboring grain centers.
+ *
+ * Author: Josh Vita
+ * Created: 2017/7
+ * Last edited: 2017/7
+ */
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "define.h"
+#include "Tools.h"
+#include "Grid.h"
+#include "Voronoi.h"
+
+using namespace std;
+
+namespace {
+
+    // Convex polyhedron around the origin, kept as a list of polygons. All
+    // face vertices share one array; face f is [start[f], start[f+1]).
+    struct Poly {
+        vector<Tools::Vec3> vert;
+        vector<int> start;
+        vector<int> nbr;
+        vector<Tools::Vec3> normal;
+        vector<double> offset;
+
+        size_t size() const { return nbr.size(); }
+
+        void clear() {
+            vert.clear();
+            start.assign(1, 0);
+            nbr.clear();
+            normal.clear();
+            offset.clear();
+        }
+
+        void swap(Poly &other) {
+            vert.swap(other.vert);
+            start.swap(other.start);
+            nbr.swap(other.nbr);
+            normal.swap(other.normal);
+            offset.swap(other.offset);
+        }
+    };
+
+    // Per-thread scratch space for building cells. Everything is cleared,
+    // not freed, between cells, so after the first few cells a thread
+    // builds cells without touching the allocator except for the result.
+    struct Workspace {
+        Poly poly;
+        Poly out;
+        vector<Tools::Vec3> cut;
+        vector<pair<double, Tools::Vec3> > ring;
+        vector<int> ids;
+        vector<Tools::Vec3> disp;
+        vector<pair<double, size_t> > order;
+    };
+
+    thread_local Workspace workspace;
+
+    void addFace(Poly &poly, const Tools::Vec3 *face, size_t n, int nbr,
+                    Tools::Vec3 normal, double offset) {
+        poly.vert.insert(poly.vert.end(), face, face+n);
+        poly.start.push_back(static_cast<int>(poly.vert.size()));
+        poly.nbr.push_back(nbr);
+        poly.normal.push_back(normal);
+        poly.offset.push_back(offset);
+    }
+
+    void boxPoly(Poly &poly, Tools::Vec3 h, int self) {
+        /* Axis-aligned box [-h,h]; for an orthorhombic cell this is where
+         * the center's own periodic images cut it off */
+
+        typedef Tools::Vec3 V;
+
+        const V faces[6][4] = {
+            {V {h.x,-h.y,-h.z}, V {h.x,h.y,-h.z}, V {h.x,h.y,h.z},
+                V {h.x,-h.y,h.z}},
+            {V {-h.x,-h.y,-h.z}, V {-h.x,-h.y,h.z}, V {-h.x,h.y,h.z},
+                V {-h.x,h.y,-h.z}},
+            {V {-h.x,h.y,-h.z}, V {-h.x,h.y,h.z}, V {h.x,h.y,h.z},
+                V {h.x,h.y,-h.z}},
+            {V {-h.x,-h.y,-h.z}, V {h.x,-h.y,-h.z}, V {h.x,-h.y,h.z},
+                V {-h.x,-h.y,h.z}},
+            {V {-h.x,-h.y,h.z}, V {h.x,-h.y,h.z}, V {h.x,h.y,h.z},
+                V {-h.x,h.y,h.z}},
+            {V {-h.x,-h.y,-h.z}, V {-h.x,h.y,-h.z}, V {h.x,h.y,-h.z},
+                V {h.x,-h.y,-h.z}}
+        };
+
+        const V normals[6] = {V {1,0,0}, V {-1,0,0}, V {0,1,0}, V {0,-1,0},
+                                V {0,0,1}, V {0,0,-1}};
+        const double offsets[6] = {h.x, h.x, h.y, h.y, h.z, h.z};
+
+        poly.clear();
+
+        for (int f=0; f<6; f++)
+            addFace(poly, faces[f], 4, self, normals[f], offsets[f]);
+    }
+
+    double maxRadius2(const Poly &poly) {
+        /* Squared distance from the origin to the furthest vertex */
+
+        double r2 = 0;
+
+        for (size_t v=0; v<poly.vert.size(); v++) {
+            r2 = max(r2, Tools::norm2(poly.vert[v]));
+        }
+
+        return r2;
+    }
+
+    bool clip(Workspace &ws, Tools::Vec3 n, double d, int nbr, double eps) {
+        /* Cuts away the part of the polyhedron where dot(n,x) > d and caps
+         * the hole with a new face. Returns false if nothing was cut.
+         *
+         * Args:
+         *  ws      -   workspace holding the polyhedron
+         *  n       -   outward unit normal of the cutting plane
+         *  d       -   plane offset
+         *  nbr     -   grain id on the other side of the plane
+         *  eps     -   distance below which a vertex counts as on the plane
+         */
+
+        Poly &poly = ws.poly;
+        bool outside = false;
+
+        for (size_t v=0; v<poly.vert.size(); v++) {
+            if (Tools::dot(n, poly.vert[v]) - d > eps) {
+                outside = true;
+                break;
+            }
+        }
+
+        if (!outside)
+            return false;
+
+        Poly &out = ws.out;
+        vector<Tools::Vec3> &cut = ws.cut;
+
+        out.clear();
+        cut.clear();
+
+        for (size_t f=0; f<poly.size(); f++) {
+            const Tools::Vec3 *face = &poly.vert[poly.start[f]];
+            size_t size = poly.start[f+1] - poly.start[f];
+            size_t first = out.vert.size();
+
+            for (size_t v=0; v<size; v++) {
+                Tools::Vec3 a = face[v];
+                Tools::Vec3 b = face[(v+1) % size];
+
+                double da = Tools::dot(n, a) - d;
+                double db = Tools::dot(n, b) - d;
+
+                if (da <= eps) {
+                    out.vert.push_back(a);
+
+                    if (da >= -eps)
+                        cut.push_back(a);
+                }
+
+                if ((da < -eps && db > eps) || (da > eps && db < -eps)) {
+                    Tools::Vec3 p = a + (b-a)*(da/(da-db));
+
+                    out.vert.push_back(p);
+                    cut.push_back(p);
+                }
+            }
+
+            // Close the face in place, or drop what is left of it
+            if (out.vert.size() - first >= 3) {
+                out.start.push_back(static_cast<int>(out.vert.size()));
+                out.nbr.push_back(poly.nbr[f]);
+                out.normal.push_back(poly.normal[f]);
+                out.offset.push_back(poly.offset[f]);
+            } else {
+                out.vert.resize(first);
+            }
+        }
+
+        // Order the cut points around the plane normal to close the hole
+        if (cut.size() >= 3) {
+            Tools::Vec3 mid = {0,0,0};
+
+            for (size_t i=0; i<cut.size(); i++)
+                mid = mid + cut[i];
+
+            mid = mid*(1.0/cut.size());
+
+            Tools::Vec3 u = (fabs(n.x) < 0.9) ? Tools::Vec3 {1,0,0} :
+                                                Tools::Vec3 {0,1,0};
+            u = Tools::cross(n, u);
+            u = u*(1/sqrt(Tools::norm2(u)));
+            Tools::Vec3 w = Tools::cross(n, u);
+
+            vector<pair<double, Tools::Vec3> > &ring = ws.ring;
+            ring.clear();
+
+            for (size_t i=0; i<cut.size(); i++) {
+                Tools::Vec3 r = cut[i] - mid;
+                ring.push_back(make_pair(atan2(Tools::dot(r, w),
+                                            Tools::dot(r, u)), cut[i]));
+            }
+
+            sort(ring.begin(), ring.end(),
+                [](const pair<double, Tools::Vec3> &a,
+                    const pair<double, Tools::Vec3> &b) {
+                    return a.first < b.first;
+                });
+
+            // Reuse 'cut' for the de-duplicated cap
+            vector<Tools::Vec3> &cap = cut;
+            cap.clear();
+
+            for (size_t i=0; i<ring.size(); i++) {
+                if (cap.empty() ||
+                        Tools::norm2(ring[i].second - cap.back()) > eps*eps)
+                    cap.push_back(ring[i].second);
+            }
+
+            while (cap.size() > 1 &&
+                    Tools::norm2(cap.front() - cap.back()) <= eps*eps)
+                cap.pop_back();
+
+            if (cap.size() >= 3)
+                addFace(out, cap.data(), cap.size(), nbr, n, d);
+        }
+
+        poly.swap(out);
+
+        return true;
+    }
+
+    int vertexIndex(vector<Tools::Vec3> &vertices, Tools::Vec3 p, double eps) {
+        /* Index of 'p' in 'vertices', adding it if it is not there yet */
+
+        for (size_t i=0; i<vertices.size(); i++) {
+            if (Tools::norm2(vertices[i] - p) <= eps*eps)
+                return static_cast<int>(i);
+        }
+
+        vertices.push_back(p);
+
+        return static_cast<int>(vertices.size()-1);
+    }
+}
+
+namespace Voronoi {
+
+    Cell computeCell(const vector<Tools::Vec3> &centers, const CenterGrid &grid,
+                        int id) {
+        /* Builds the periodic Voronoi polyhedron of one grain. The cell
+         * starts as the box around the center and is clipped by the
+         * bisecting planes of neighboring centers, nearest first. Neighbors
+         * are pulled from the grid in growing spheres until no center left
+         * outside can reach the cell. Orthorhombic boxes only.
+         *
+         * Args:
+         *  centers     -   grain centers
+         *  grid        -   bucket grid built over 'centers'
+         *  id          -   grain to build
+         *
+         * Returns:
+         *  cell        -   the polyhedron around centers[id]
+         */
+
+        Tools::Vec3 box = grid.box;
+        Tools::Vec3 c = centers[id];
+
+        double scale = max(box.x, max(box.y, box.z));
+        double eps = 1e-10*scale;
+
+        Workspace &ws = workspace;
+        Poly &poly = ws.poly;
+
+        boxPoly(poly, box*0.5, id);
+
+        double spacing = cbrt(box.x*box.y*box.z / centers.size());
+        double r2max = maxRadius2(poly);
+        double r = min(2*sqrt(r2max), 3*spacing);
+        double done = 0;
+
+        vector<int> &ids = ws.ids;
+        vector<Tools::Vec3> &disp = ws.disp;
+        vector<pair<double, size_t> > &order = ws.order;
+
+        while (true) {
+            grid.within(c, r, ids, disp);
+
+            order.clear();
+
+            for (size_t k=0; k<ids.size(); k++)
+                order.push_back(make_pair(Tools::norm2(disp[k]), k));
+
+            sort(order.begin(), order.end());
+
+            for (size_t o=0; o<order.size(); o++) {
+                double dist = sqrt(order[o].first);
+
+                // Skip the center itself and planes already applied
+                if (dist <= eps || dist < done)
+                    continue;
+
+                // Sorted by distance, so nothing further can cut either
+                if (dist*dist/4 >= r2max)
+                    break;
+
+                Tools::Vec3 n = disp[order[o].second]*(1/dist);
+
+                if (clip(ws, n, dist/2, ids[order[o].second], eps))
+                    r2max = maxRadius2(poly);
+            }
+
+            if (4*r2max <= r*r)
+                break;
+
+            done = r;
+            r = 2*sqrt(r2max) + eps;
+        }
+
+        // Gather unique vertices and absolute face planes
+        Cell cell;
+        cell.id = id;
+        cell.center = c;
+        cell.volume = 0;
+        cell.lo = c;
+        cell.hi = c;
+
+        for (size_t f=0; f<poly.size(); f++) {
+            vector<int> face;
+
+            for (int v=poly.start[f]; v<poly.start[f+1]; v++) {
+                int k = vertexIndex(cell.vertices, poly.vert[v], eps);
+
+                if (face.empty() || (face.back() != k && face.front() != k))
+                    face.push_back(k);
+            }
+
+            if (face.size() < 3)
+                continue;
+
+            // Tetrahedra fanned out from the center
+            for (size_t v=1; v+1<face.size(); v++) {
+                Tools::Vec3 a = cell.vertices[face[0]];
+                Tools::Vec3 b = cell.vertices[face[v]];
+                Tools::Vec3 e = cell.vertices[face[v+1]];
+
+                cell.volume += Tools::dot(a, Tools::cross(b, e))/6.0;
+            }
+
+            cell.faces.push_back(face);
+            cell.faceNeighbor.push_back(poly.nbr[f]);
+            cell.faceNormal.push_back(poly.normal[f]);
+            cell.faceOffset.push_back(poly.offset[f] +
+                                        Tools::dot(poly.normal[f], c));
+
+            if (poly.nbr[f] != id)
+                cell.neighbors.push_back(poly.nbr[f]);
+        }
+
+        for (size_t v=0; v<cell.vertices.size(); v++) {
+            Tools::Vec3 p = cell.vertices[v] + c;
+            cell.vertices[v] = p;
+
+            cell.lo = Tools::Vec3 {min(cell.lo.x, p.x), min(cell.lo.y, p.y),
+                                    min(cell.lo.z, p.z)};
+            cell.hi = Tools::Vec3 {max(cell.hi.x, p.x), max(cell.hi.y, p.y),
+                                    max(cell.hi.z, p.z)};
+        }
+
+        sort(cell.neighbors.begin(), cell.neighbors.end());
+        cell.neighbors.erase(unique(cell.neighbors.begin(),
+                                    cell.neighbors.end()),
+                                cell.neighbors.end());
+
+        return cell;
+    }
+
+    vector<Cell> computeCells(const vector<Tools::Vec3> &centers,
+                                Tools::Vec3 boxDims) {
+        /* Builds the periodic Voronoi polyhedra of every grain.
+         *
+         * Args:
+         *  centers     -   grain centers
+         *  boxDims     -   xyz size of the periodic box (origin as lower
+         *                  bound)
+         *
+         * Returns:
+         *  cells       -   one polyhedron per center, in center order
+         */
+
+        CenterGrid grid;
+        grid.build(centers, boxDims);
+
+        vector<Cell> cells;
+        cells.reserve(centers.size());
+
+        for (size_t i=0; i<centers.size(); i++) {
+            cells.push_back(computeCell(centers, grid, static_cast<int>(i)));
+        }
+
+        return cells;
+    }
+
+    bool contains(const Cell &cell, Tools::Vec3 p, double tol) {
+        /* Returns 'true' if the (unwrapped) point lies inside the cell, or
+         * within 'tol' outside of any of its faces */
+
+        for (size_t f=0; f<cell.faces.size(); f++) {
+            if (Tools::dot(cell.faceNormal[f], p) - cell.faceOffset[f] > tol)
+                return false;
+        }
+
+        return true;
+    }
+}
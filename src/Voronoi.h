@@ -0,0 +1,50 @@
+#ifndef VORONOI_H
+#define VORONOI_H
+
+#include <vector>
+#include "define.h"
+#include "Tools.h"
+#include "Grid.h"
+
+using namespace std;
+
+namespace Voronoi {
+
+    /* Periodic Voronoi polyhedron of one grain. Coordinates are absolute and
+     * unwrapped: the cell surrounds its center and may stick out of the box.
+     */
+    struct Cell {
+        int id;
+        Tools::Vec3 center;
+
+        vector<Tools::Vec3> vertices;
+
+        // Vertex indices of each face, counter-clockwise seen from outside
+        vector<vector<int> > faces;
+
+        // Grain on the other side of each face (own id for periodic self
+        // contact)
+        vector<int> faceNeighbor;
+
+        // Outward unit normal and offset of each face plane; points inside
+        // satisfy dot(normal, p) <= offset
+        vector<Tools::Vec3> faceNormal;
+        vector<double> faceOffset;
+
+        // Sorted ids of the other grains this cell touches
+        vector<int> neighbors;
+
+        double volume;
+
+        Tools::Vec3 lo;
+        Tools::Vec3 hi;
+    };
+
+    Cell computeCell(const vector<Tools::Vec3>&, const CenterGrid&, int);
+
+    vector<Cell> computeCells(const vector<Tools::Vec3>&, Tools::Vec3);
+
+    bool contains(const Cell&, Tools::Vec3, double tol=0.0);
+}
+
+#endif
@@ -0,0 +1,118 @@
+#include "UnitTest++/UnitTest++.h"
+#include <vector>
+#include <iostream>
+#include <cmath>
+#include "define.h"
+#include "Atoms.h"
+#include "Tools.h"
+#include "Grain.h"
+
+const double tolerance = 1e-10;
+
+using namespace std;
+
+SUITE(atomsContainer) {
+    TEST(pushBackAndView) {
+        Atoms atoms;
+
+        atoms.push_back(1, 0.5, 1.5, 2.5);
+        atoms.push_back(2, 3.0, 4.0, 5.0, 7);
+
+        AtomView v = atoms.view();
+
+        CHECK_EQUAL(2u, v.size());
+        CHECK_EQUAL(2, v.type[1]);
+        CHECK_EQUAL(-1, v.grain[0]);
+        CHECK_EQUAL(7, v.grain[1]);
+        CHECK_CLOSE(1.5, v.y[0], tolerance);
+    }
+
+    TEST(viewWritesThrough) {
+        Atoms atoms;
+
+        atoms.push_back(1, 0, 0, 0);
+        atoms.push_back(1, 1, 1, 1);
+        atoms.push_back(1, 2, 2, 2);
+
+        AtomView v = atoms.view(1, 2);
+        v.x[0] = 10;
+
+        CHECK_EQUAL(2u, v.size());
+        CHECK_CLOSE(10, atoms.x[1], tolerance);
+        CHECK_CLOSE(2, v.slice(1, 1).z[0], tolerance);
+    }
+
+    TEST(arrayRoundTrip) {
+        vector<dvec_t> arr;
+
+        arr.push_back(dvec_t {1,0.1,0.2,0.3});
+        arr.push_back(dvec_t {2,1.1,1.2,1.3});
+
+        Atoms atoms = Atoms::fromArray(arr, 3);
+        vector<dvec_t> back = atoms.toArray();
+
+        CHECK_EQUAL(3, atoms.grain[1]);
+        CHECK_ARRAY2D_CLOSE(arr, back, 2, 4, tolerance);
+    }
+}
+
+SUITE(atomsInPlace) {
+    TEST(joinAppends) {
+        Atoms a1;
+        Atoms a2;
+
+        a1.push_back(1, 1, 1, 1);
+        a2.push_back(2, 2, 2, 2);
+        a2.push_back(2, 3, 3, 3);
+
+        Tools::joinArrays(a1, a2.view());
+
+        CHECK_EQUAL(3u, a1.size());
+        CHECK_EQUAL(2, a1.type[2]);
+        CHECK_CLOSE(3, a1.z[2], tolerance);
+    }
+
+    TEST(rotateMatchesRows) {
+        vector<dvec_t> rows;
+
+        rows.push_back(dvec_t {1,1,0,0});
+        rows.push_back(dvec_t {2,0,2,1});
+
+        Atoms atoms = Atoms::fromArray(rows);
+
+        dvec_t axis = {1,1,1};
+        Tools::rotate(rows, 0.7, axis);
+        Tools::rotate(atoms.view(), 0.7, axis);
+
+        CHECK_ARRAY2D_CLOSE(rows, atoms.toArray(), 2, 4, tolerance);
+    }
+
+    TEST(shiftGrain) {
+        Atoms atoms;
+
+        atoms.push_back(1, 0, 0, 0);
+        atoms.push_back(1, 1, 2, 3);
+
+        Grain::shiftGrain(atoms.view(), Tools::Vec3 {1,-1,0.5});
+
+        CHECK_CLOSE(2, atoms.x[1], tolerance);
+        CHECK_CLOSE(1, atoms.y[1], tolerance);
+        CHECK_CLOSE(0.5, atoms.z[0], tolerance);
+    }
+
+    TEST(genGrainMatchesRows) {
+        dvec_t dims = {2,2,2};
+        vector<dvec_t> basis;
+
+        basis.push_back(dvec_t {0,0,0});
+        basis.push_back(dvec_t {0.5,0.5,0});
+
+        vector<dvec_t> rows = Grain::genGrain(dims, basis, 1.0, 1.0);
+
+        Atoms atoms;
+        Grain::genGrain(atoms, Tools::toVec3(dims), basis, 1.0, 1);
+
+        CHECK_EQUAL(rows.size(), atoms.size());
+        CHECK_ARRAY2D_CLOSE(rows, atoms.toArray(), rows.size(), 4, tolerance);
+    }
+}
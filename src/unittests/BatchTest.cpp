@@ -0,0 +1,88 @@
+#include "UnitTest++/UnitTest++.h"
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <stdexcept>
+#include "Batch.h"
+
+using namespace std;
+
+SUITE(batch) {
+    TEST(seedRangeAndNames) {
+        vector<Batch::Job> jobs;
+        Batch::parse("40 3.6 20 8-10 run_{side}_{grains}_{seed}.data.gz",
+                        jobs);
+        Batch::parse("   # comment only", jobs);
+        Batch::parse("", jobs);
+        Batch::parse("80 4.05 160 3 big.pv3d  # one seed", jobs);
+
+        CHECK_EQUAL(4u, jobs.size());
+        CHECK_EQUAL(8u, jobs[0].seed);
+        CHECK_EQUAL(10u, jobs[2].seed);
+        CHECK_EQUAL("run_40_20_9.data.gz", jobs[1].output);
+        CHECK_CLOSE(40.0, jobs[2].side, 1e-12);
+        CHECK_CLOSE(3.6, jobs[2].latConst, 1e-12);
+        CHECK_EQUAL(20, jobs[2].grains);
+        CHECK_EQUAL("big.pv3d", jobs[3].output);
+        CHECK_EQUAL(160, jobs[3].grains);
+
+        Batch::check(jobs);
+    }
+
+    TEST(badLines) {
+        const char *bad[] = {
+            "40 3.6 20 1",                      // no output
+            "40 3.6 20 1 a.data extra",
+            "40 3.6 0 1 a.data",                // no grains
+            "-40 3.6 20 1 a.data",
+            "40 3.6x 20 1 a.data",
+            "40 3.6 20 5-2 a_{seed}.data",      // empty range
+            "40 3.6 20 -5 a.data",
+            "40 3.6 20 1-3 a.data"              // one name for three seeds
+        };
+
+        for (size_t b=0; b<sizeof(bad)/sizeof(bad[0]); b++) {
+            vector<Batch::Job> jobs;
+            CHECK_THROW(Batch::parse(bad[b], jobs), invalid_argument);
+        }
+
+        vector<Batch::Job> jobs;
+        Batch::parse("40 3.6 20 1-2 a_{seed}.data", jobs);
+        Batch::parse("40 3.6 20 2 a_2.data", jobs);
+
+        CHECK_THROW(Batch::check(jobs), invalid_argument);
+    }
+
+    TEST(readFile) {
+        {
+            ofstream out("batchTest.txt");
+            out << "# side latConst grains seeds output\n"
+                << "10 3.6 2 1-2 a_{seed}.data\n"
+                << "\n"
+                << "20 3.6 4 7 b.data\n";
+        }
+
+        vector<Batch::Job> jobs = Batch::read("batchTest.txt");
+
+        CHECK_EQUAL(3u, jobs.size());
+        CHECK_EQUAL("b.data", jobs[2].output);
+
+        {
+            ofstream out("batchTest.txt");
+            out << "10 3.6 2 1 a.data\n"
+                << "10 3.6 x 1 b.data\n";
+        }
+
+        try {
+            Batch::read("batchTest.txt");
+            CHECK(false);
+        } catch (const invalid_argument &e) {
+            CHECK(string(e.what()).find("batchTest.txt:2:") == 0);
+        }
+
+        remove("batchTest.txt");
+
+        CHECK_THROW(Batch::read("noSuchBatchFile.txt"), runtime_error);
+    }
+}
@@ -0,0 +1,135 @@
+#include "UnitTest++/UnitTest++.h"
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include "Atoms.h"
+#include "Tools.h"
+#include "Lammps.h"
+#include "Binary.h"
+#include "TestTools.h"
+
+using namespace std;
+using TestTools::rnd;
+
+namespace {
+
+    string readFile(const string &filename) {
+        ifstream in(filename.c_str());
+        stringstream text;
+        text << in.rdbuf();
+
+        return text.str();
+    }
+
+    // Two chunks; grain 1 has a run in each
+    void chunks(Atoms &a, Atoms &b) {
+        srand(2);
+
+        for (int i=0; i<50; i++)
+            a.push_back(1 + i%2, rnd()*20, rnd()*20, rnd()*20,
+                        i < 20 ? 0 : 1);
+
+        for (int i=0; i<30; i++)
+            b.push_back(3, rnd()*20, rnd()*20, rnd()*20,
+                        i < 10 ? 1 : 2);
+    }
+}
+
+SUITE(binary) {
+    TEST(roundTripAndIndex) {
+        Atoms a, b;
+        chunks(a, b);
+
+        Tools::Box box = {Tools::Vec3 {1,2,3}, Tools::Vec3 {4,5,6}, 0.1, 0.2,
+                            0.3};
+
+        Binary::Writer writer;
+        writer.open("binaryTest.pv3d", box);
+        writer.write(a.view());
+        writer.write(b.view());
+        writer.close();
+
+        CHECK(Binary::isBinary("binaryTest.pv3d"));
+
+        Binary::File file;
+        file.open("binaryTest.pv3d");
+
+        CHECK_EQUAL(80u, file.header.nAtoms);
+        CHECK_EQUAL(4u, file.header.nRuns);
+        CHECK_EQUAL(3, file.header.nTypes);
+        CHECK_CLOSE(0.2, file.box().xz, 1e-15);
+        CHECK_CLOSE(5, file.box().len.y, 1e-15);
+
+        vector<size_t> runs = file.runsOf(1);
+        CHECK_EQUAL(2u, runs.size());
+
+        // Views point into the mapping
+        AtomView view = file.run(runs[1]);
+        CHECK(reinterpret_cast<char*>(view.x) > file.data);
+        CHECK(reinterpret_cast<char*>(view.x) < file.data + file.size);
+        CHECK_EQUAL(10u, view.size());
+        CHECK_EQUAL(b.x[0], view.x[0]);
+        CHECK_EQUAL(1, view.grain[9]);
+
+        Atoms grain1 = file.grain(1);
+        CHECK_EQUAL(40u, grain1.size());
+        CHECK_EQUAL(a.y[20], grain1.y[0]);
+        CHECK_EQUAL(b.z[9], grain1.z[39]);
+        CHECK_EQUAL(0u, file.grain(7).size());
+
+        Atoms all = file.atoms();
+        Atoms expected = a;
+        expected.append(b.view());
+
+        CHECK(expected.x == all.x);
+        CHECK(expected.y == all.y);
+        CHECK(expected.z == all.z);
+        CHECK(expected.type == all.type);
+        CHECK(expected.grain == all.grain);
+
+        file.close();
+        remove("binaryTest.pv3d");
+    }
+
+    TEST(convertsLammps) {
+        Atoms a, b;
+        chunks(a, b);
+        a.append(b.view());
+
+        Tools::Box box = {Tools::Vec3 {0,0,0}, Tools::Vec3 {9,9,9}, 0, 0, 0};
+        Lammps::writeData("convertTest.data", a.view(), box);
+
+        Binary::fromLammps("convertTest.data", "convertTest.pv3d");
+        CHECK(!Binary::isBinary("convertTest.data"));
+
+        Binary::File file;
+        file.open("convertTest.pv3d");
+        CHECK_EQUAL(80u, file.header.nAtoms);
+        CHECK_EQUAL(-1, file.run(0).grain[0]);
+        file.close();
+
+        Binary::toLammps("convertTest.pv3d", "convertBack.data");
+        CHECK(readFile("convertTest.data") == readFile("convertBack.data"));
+
+        remove("convertTest.data");
+        remove("convertTest.pv3d");
+        remove("convertBack.data");
+    }
+
+    TEST(notBinary) {
+        FILE *f = fopen("notBinary.pv3d", "w");
+        fprintf(f, "LAMMPS data file, long enough to hold a whole header "
+                    "of the binary format, but not one.................\n");
+        fclose(f);
+
+        Binary::File file;
+        CHECK_THROW(file.open("notBinary.pv3d"), runtime_error);
+        CHECK_THROW(file.open("noSuchFile.pv3d"), runtime_error);
+
+        remove("notBinary.pv3d");
+    }
+}
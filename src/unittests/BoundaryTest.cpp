@@ -0,0 +1,193 @@
+#include "UnitTest++/UnitTest++.h"
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "Atoms.h"
+#include "Tools.h"
+#include "Voronoi.h"
+#include "Boundary.h"
+#include "TestTools.h"
+
+using namespace std;
+using TestTools::rnd;
+
+namespace {
+
+    int nearest(Tools::Vec3 p, const vector<Tools::Vec3> &centers,
+                const Tools::Box &box) {
+        int best = 0;
+
+        for (size_t c=1; c<centers.size(); c++) {
+            if (Tools::norm2(Tools::minImage(p - centers[c], box)) <
+                    Tools::norm2(Tools::minImage(p - centers[best], box)))
+                best = c;
+        }
+
+        return best;
+    }
+
+    double bisectorDistance(Tools::Vec3 p, const vector<Tools::Vec3> &centers,
+                            int g, const Tools::Box &box) {
+        /* Reference: distance to the nearest bisector plane between the
+         * own center and any image of another grain's center */
+
+        Tools::Vec3 own = centers[g];
+        Tools::Vec3 q = own + Tools::minImage(p - own, box);
+        double best = numeric_limits<double>::max();
+
+        for (size_t c=0; c<centers.size(); c++) {
+            if (static_cast<int>(c) == g)
+                continue;
+
+            for (int i=-1; i<=1; i++) {
+                for (int j=-1; j<=1; j++) {
+                    for (int k=-1; k<=1; k++) {
+                        Tools::Vec3 other = centers[c] + Tools::Vec3 {
+                            i*box.len.x, j*box.len.y, k*box.len.z};
+
+                        double d = (Tools::norm2(q - other) -
+                                    Tools::norm2(q - own)) /
+                                    (2*sqrt(Tools::norm2(other - own)));
+                        best = min(best, d);
+                    }
+                }
+            }
+        }
+
+        return best;
+    }
+}
+
+SUITE(boundary) {
+    TEST(matchesBisectors) {
+        srand(11);
+
+        Tools::Vec3 len = {10, 12, 9};
+        Tools::Box box = {Tools::Vec3 {0,0,0}, len, 0, 0, 0};
+        vector<Tools::Vec3> centers;
+
+        for (int c=0; c<12; c++)
+            centers.push_back(Tools::Vec3 {rnd()*len.x, rnd()*len.y,
+                                            rnd()*len.z});
+
+        vector<Voronoi::Cell> cells = Voronoi::computeCells(centers, len);
+
+        Atoms atoms;
+
+        for (int a=0; a<2000; a++) {
+            Tools::Vec3 p = {rnd()*len.x, rnd()*len.y, rnd()*len.z};
+            atoms.push_back(1, p.x, p.y, p.z);
+            atoms.grain[a] = nearest(p, centers, box);
+        }
+
+        vector<double> d(atoms.size());
+        Boundary::distances(atoms.view(), cells, box, d.data());
+
+        int wrong = 0;
+
+        for (size_t a=0; a<atoms.size(); a++) {
+            Tools::Vec3 p = {atoms.x[a], atoms.y[a], atoms.z[a]};
+            double expected = bisectorDistance(p, centers, atoms.grain[a],
+                                                box);
+            wrong += fabs(d[a] - expected) > 1e-9;
+        }
+
+        CHECK_EQUAL(0, wrong);
+    }
+
+    TEST(tagsWithinDistance) {
+        vector<Tools::Vec3> centers = {Tools::Vec3 {2.5, 5, 5},
+                                        Tools::Vec3 {7.5, 5, 5}};
+        Tools::Vec3 len = {10, 10, 10};
+        Tools::Box box = {Tools::Vec3 {0,0,0}, len, 0, 0, 0};
+
+        vector<Voronoi::Cell> cells = Voronoi::computeCells(centers, len);
+
+        // The boundaries are the planes x = 0 and x = 5; the grains meet
+        // only themselves across y and z, which are no boundaries
+        Atoms atoms;
+        atoms.push_back(1, 2.5, 0.5, 9.5);
+        atoms.push_back(1, 4.5, 5, 5);
+        atoms.push_back(1, 9.8, 5, 0.2);
+        atoms.push_back(1, 6.5, 5, 5);
+        atoms.push_back(1, 0.1, 5, 5);
+        atoms.grain[0] = 0;
+        atoms.grain[1] = 0;
+        atoms.grain[2] = 1;
+        atoms.grain[3] = 1;
+
+        vector<double> d(atoms.size());
+        Boundary::distances(atoms.view(), cells, box, d.data());
+
+        CHECK_CLOSE(2.5, d[0], 1e-12);
+        CHECK_CLOSE(0.5, d[1], 1e-12);
+        CHECK_CLOSE(0.2, d[2], 1e-12);
+        CHECK_CLOSE(1.5, d[3], 1e-12);
+        CHECK_EQUAL(0.0, d[4]);
+
+        vector<double> tag(atoms.size());
+        Boundary::tags(atoms.view(), cells, box, 1.0, tag.data());
+
+        CHECK_EQUAL(0.0, tag[0]);
+        CHECK_EQUAL(1.0, tag[1]);
+        CHECK_EQUAL(1.0, tag[2]);
+        CHECK_EQUAL(0.0, tag[3]);
+        CHECK_EQUAL(0.0, tag[4]);
+    }
+
+    TEST(measuresAcrossSelfContacts) {
+        // In the plane a centered rectangular lattice: grain 0 meets grain
+        // 1 across the oblique faces 5x+3y = 17 (taken from its center) and
+        // itself across y = +-3. The box is thin in z, so z is a self
+        // contact too.
+        vector<Tools::Vec3> centers = {Tools::Vec3 {3, 2, 1},
+                                        Tools::Vec3 {8, 5, 1}};
+        Tools::Vec3 len = {10, 6, 2};
+        Tools::Box box = {Tools::Vec3 {0,0,0}, len, 0, 0, 0};
+
+        vector<Voronoi::Cell> cells = Voronoi::computeCells(centers, len);
+
+        Atoms atoms;
+        atoms.push_back(1, 4, 2, 1);
+        atoms.push_back(1, 3, 4.8, 1);
+        atoms.grain[0] = 0;
+        atoms.grain[1] = 0;
+
+        vector<double> d(atoms.size());
+        Boundary::distances(atoms.view(), cells, box, d.data());
+
+        // The foot on the nearest bisector lies on the face
+        CHECK_CLOSE(12/sqrt(34.0), d[0], 1e-9);
+
+        // The foot lies past the self contact, at y = 3.06; the nearest
+        // boundary is the corner (1.6, 3), not the plane 1.475 away
+        CHECK_CLOSE(sqrt(2.6), d[1], 1e-9);
+    }
+
+    TEST(singleGrainHasNoBoundary) {
+        vector<Tools::Vec3> centers = {Tools::Vec3 {3, 4, 5}};
+        Tools::Vec3 len = {30, 30, 30};
+        Tools::Box box = {Tools::Vec3 {0,0,0}, len, 0, 0, 0};
+
+        vector<Voronoi::Cell> cells = Voronoi::computeCells(centers, len);
+
+        Atoms atoms;
+
+        for (int a=0; a<100; a++) {
+            atoms.push_back(1, 0.3*a, 29.99 - 0.29*a, 18);
+            atoms.grain[a] = 0;
+        }
+
+        vector<double> tag(atoms.size());
+        Boundary::tags(atoms.view(), cells, box, 2.0, tag.data());
+
+        CHECK_EQUAL(0, count(tag.begin(), tag.end(), 1.0));
+
+        vector<double> d(atoms.size());
+        Boundary::distances(atoms.view(), cells, box, d.data());
+
+        CHECK(isinf(d[0]) && isinf(d[99]));
+    }
+}
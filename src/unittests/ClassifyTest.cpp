@@ -0,0 +1,181 @@
+#include "UnitTest++/UnitTest++.h"
+#include <vector>
+#include <cstdlib>
+#include "define.h"
+#include "Atoms.h"
+#include "Tools.h"
+#include "Grid.h"
+#include "Classify.h"
+#include "TestTools.h"
+
+using namespace std;
+using TestTools::rnd;
+
+namespace {
+
+    vector<Tools::Vec3> imagesOf(const vector<Tools::Vec3> &centers,
+                                    Tools::Vec3 box, vector<int> &ids) {
+        /* All 27 images of each center, in blocks of 27 */
+
+        vector<Tools::Vec3> images;
+
+        for (size_t c=0; c<centers.size(); c++) {
+            for (int i=-1; i<2; i++) {
+                for (int j=-1; j<2; j++) {
+                    for (int k=-1; k<2; k++) {
+                        images.push_back(centers[c] +
+                            Tools::Vec3 {i*box.x, j*box.y, k*box.z});
+                        ids.push_back(static_cast<int>(c));
+                    }
+                }
+            }
+        }
+
+        return images;
+    }
+}
+
+SUITE(batchClassify) {
+    TEST(twoCenters) {
+        vector<Tools::Vec3> points;
+        vector<int> ids;
+
+        points.push_back(Tools::Vec3 {0,0,0});
+        points.push_back(Tools::Vec3 {2,0,0});
+        ids.push_back(4);
+        ids.push_back(9);
+
+        Classify::Centers c = Classify::pack(points, ids);
+
+        Atoms atoms;
+        atoms.push_back(1, 0.5, 0, 0);
+        atoms.push_back(1, 1.5, 0, 0);
+        atoms.push_back(1, 3.0, 1, 0);
+
+        int owner[3];
+        Classify::nearest(atoms.view(), c, owner);
+
+        CHECK_EQUAL(4, owner[0]);
+        CHECK_EQUAL(9, owner[1]);
+        CHECK_EQUAL(9, owner[2]);
+
+        // Safe radius is half of the distance between the two centers
+        CHECK_CLOSE(1.0, c.safe2[0], 1e-12);
+    }
+
+    TEST(matchesGridWithHint) {
+        srand(11);
+
+        Tools::Vec3 box = {20,25,30};
+        vector<Tools::Vec3> centers;
+
+        for (int c=0; c<9; c++) {
+            centers.push_back(Tools::Vec3 {rnd()*box.x, rnd()*box.y,
+                                            rnd()*box.z});
+        }
+
+        vector<int> ids;
+        vector<Tools::Vec3> images = imagesOf(centers, box, ids);
+
+        Classify::Centers packed = Classify::pack(images, ids);
+
+        CenterGrid grid;
+        grid.build(centers, box);
+
+        Atoms atoms;
+
+        for (int a=0; a<3000; a++) {
+            atoms.push_back(1, rnd()*box.x, rnd()*box.y, rnd()*box.z);
+        }
+
+        vector<int> scan(atoms.size());
+        vector<int> hinted(atoms.size());
+        vector<int> gridded(atoms.size());
+
+        // Image 13 of each block is the unshifted center
+        Classify::nearest(atoms.view(), packed, scan.data());
+        Classify::nearest(atoms.view(), packed, hinted.data(), 27*3+13);
+        Classify::nearest(atoms.view(), grid, gridded.data());
+
+        CHECK_ARRAY_EQUAL(gridded, scan, atoms.size());
+        CHECK_ARRAY_EQUAL(gridded, hinted, atoms.size());
+    }
+
+    TEST(minimumImageMatchesImages) {
+        srand(5);
+
+        Tools::Vec3 len = {20,25,30};
+        Tools::Box box = {Tools::Vec3 {0,0,0}, len, 0, 0, 0};
+        vector<Tools::Vec3> centers;
+
+        for (int c=0; c<9; c++) {
+            centers.push_back(Tools::Vec3 {rnd()*len.x, rnd()*len.y,
+                                            rnd()*len.z});
+        }
+
+        vector<int> ids;
+        vector<Tools::Vec3> images = imagesOf(centers, len, ids);
+
+        Classify::Centers withImages = Classify::pack(images, ids);
+        Classify::Centers periodic = Classify::pack(centers, box);
+
+        CHECK_EQUAL(9u, periodic.n);
+
+        Atoms atoms;
+
+        for (int a=0; a<3000; a++) {
+            atoms.push_back(1, rnd()*len.x, rnd()*len.y, rnd()*len.z);
+        }
+
+        vector<int> expected(atoms.size());
+        vector<int> found(atoms.size());
+        vector<int> hinted(atoms.size());
+
+        Classify::nearest(atoms.view(), withImages, expected.data());
+        Classify::nearest(atoms.view(), periodic, found.data());
+        Classify::nearest(atoms.view(), periodic, hinted.data(), 4);
+
+        CHECK_ARRAY_EQUAL(expected, found, atoms.size());
+        CHECK_ARRAY_EQUAL(expected, hinted, atoms.size());
+    }
+}
+
+SUITE(periodicBox) {
+    TEST(orthoMinImage) {
+        Tools::Box box = {Tools::Vec3 {0,0,0}, Tools::Vec3 {10,10,10}, 0,0,0};
+
+        Tools::Vec3 d = Tools::minImage(Tools::Vec3 {6,-7,5}, box);
+
+        CHECK_CLOSE(-4, d.x, 1e-12);
+        CHECK_CLOSE(3, d.y, 1e-12);
+
+        // Half-open: +L/2 maps to -L/2
+        CHECK_CLOSE(-5, d.z, 1e-12);
+    }
+
+    TEST(wrapIntoBox) {
+        Tools::Box box = {Tools::Vec3 {1,1,1}, Tools::Vec3 {10,10,10}, 0,0,0};
+
+        Tools::Vec3 p = Tools::wrap(Tools::Vec3 {11,-3,25.5}, box);
+
+        CHECK_CLOSE(1, p.x, 1e-12);
+        CHECK_CLOSE(7, p.y, 1e-12);
+        CHECK_CLOSE(5.5, p.z, 1e-12);
+    }
+
+    TEST(triclinicWrap) {
+        Tools::Box box = {Tools::Vec3 {0,0,0}, Tools::Vec3 {10,10,10}, 2,1,3};
+
+        // One step along c = (1,3,10) lands back on the same site
+        Tools::Vec3 p = Tools::wrap(Tools::Vec3 {4,5,6}, box);
+        Tools::Vec3 q = Tools::wrap(Tools::Vec3 {5,8,16}, box);
+
+        CHECK_CLOSE(p.x, q.x, 1e-12);
+        CHECK_CLOSE(p.y, q.y, 1e-12);
+        CHECK_CLOSE(p.z, q.z, 1e-12);
+
+        Tools::Vec3 d = Tools::minImage(Tools::Vec3 {1,3,10}, box);
+
+        CHECK_CLOSE(0, Tools::norm2(d), 1e-12);
+    }
+}
@@ -0,0 +1,280 @@
+#include "UnitTest++/UnitTest++.h"
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include "define.h"
+#include "Atoms.h"
+#include "Tools.h"
+#include "Grid.h"
+#include "Classify.h"
+#include "Voronoi.h"
+#include "Lattice.h"
+#include "Grain.h"
+#include "TestTools.h"
+
+using namespace std;
+using TestTools::rnd;
+
+namespace {
+
+    // The two sublattices of B1, each as a lattice of its own
+    struct B1Cation {
+        static constexpr int nSub = 1;
+        static constexpr int nSites = 4;
+        static constexpr Tools::Vec3 cell = {1, 1, 1};
+        static constexpr Lattice::Site sites[nSites] = {
+            {0, 0, 0, 0}, {0.5, 0.5, 0, 0}, {0, 0.5, 0.5, 0}, {0.5, 0, 0.5, 0}
+        };
+    };
+
+    struct B1Anion {
+        static constexpr int nSub = 1;
+        static constexpr int nSites = 4;
+        static constexpr Tools::Vec3 cell = {1, 1, 1};
+        static constexpr Lattice::Site sites[nSites] = {
+            {0.5, 0.5, 0.5, 0}, {0, 0, 0.5, 0}, {0, 0.5, 0, 0}, {0.5, 0, 0, 0}
+        };
+    };
+
+    vector<Tools::Vec3> sorted(const AtomView &atoms) {
+        vector<Tools::Vec3> p;
+
+        for (size_t a=0; a<atoms.size(); a++)
+            p.push_back(Tools::Vec3 {atoms.x[a], atoms.y[a], atoms.z[a]});
+
+        sort(p.begin(), p.end(), [](Tools::Vec3 u, Tools::Vec3 v) {
+            if (u.x != v.x) return u.x < v.x;
+            if (u.y != v.y) return u.y < v.y;
+            return u.z < v.z;
+        });
+
+        return p;
+    }
+
+    template<class L>
+    Atoms fillBox(int reps, double latConst, const int (&types)[L::nSub]) {
+        /* One grain filling a box of reps^3 conventional cells */
+
+        Tools::Vec3 len = L::cell*(reps*latConst);
+        Tools::Box box = {Tools::Vec3 {0,0,0}, len, 0, 0, 0};
+
+        vector<Tools::Vec3> centers(1, len*0.5);
+        vector<Voronoi::Cell> cells = Voronoi::computeCells(centers, len);
+
+        Atoms inside, edge;
+        Grain::genGrainInCell<L>(inside, edge, cells[0], latConst, types,
+                                    Tools::identity(), box);
+
+        // Same filter as Grain::keepOwnCell; every site belongs to grain 0.
+        // The lattice fits the box, so sites sit right on the half-box
+        // faces: nudge them off so rounding cannot keep both copies.
+        Tools::Vec3 nudge = {1e-9, 1e-9, 1e-9};
+
+        for (size_t a=0; a<edge.size(); a++) {
+            Tools::Vec3 d = {edge.x[a]-centers[0].x, edge.y[a]-centers[0].y,
+                                edge.z[a]-centers[0].z};
+            d = d + nudge;
+            Tools::Vec3 mi = Tools::minImage(d, box);
+
+            if (mi.x == d.x && mi.y == d.y && mi.z == d.z) {
+                Tools::Vec3 p = Tools::wrap(centers[0] + d - nudge, box);
+                inside.push_back(edge.type[a], p.x, p.y, p.z, 0);
+            }
+        }
+
+        return inside;
+    }
+
+    double minDistance(const Atoms &atoms, Tools::Box box) {
+        double best = 1e300;
+
+        for (size_t a=0; a<atoms.size(); a++) {
+            for (size_t b=a+1; b<atoms.size(); b++) {
+                Tools::Vec3 d = {atoms.x[a]-atoms.x[b], atoms.y[a]-atoms.y[b],
+                                    atoms.z[a]-atoms.z[b]};
+                best = min(best, Tools::norm2(Tools::minImage(d, box)));
+            }
+        }
+
+        return sqrt(best);
+    }
+
+    template<class L>
+    void checkLattice(double nearest) {
+        const int types[L::nSub] = {};
+        int reps = 3;
+        double latConst = 2.0;
+
+        Atoms atoms = fillBox<L>(reps, latConst, types);
+        Tools::Vec3 len = L::cell*(reps*latConst);
+        Tools::Box box = {Tools::Vec3 {0,0,0}, len, 0, 0, 0};
+
+        CHECK_EQUAL(static_cast<size_t>(L::nSites*reps*reps*reps),
+                    atoms.size());
+        CHECK_CLOSE(nearest*latConst, minDistance(atoms, box), 1e-9);
+    }
+}
+
+SUITE(genGrainInCell) {
+    TEST(matchesFullBlock) {
+        srand(9);
+
+        Tools::Vec3 len = {18,18,18};
+        Tools::Box box = {Tools::Vec3 {0,0,0}, len, 0, 0, 0};
+        double latConst = 3.0;
+
+        vector<Tools::Vec3> centers;
+
+        for (int c=0; c<6; c++) {
+            centers.push_back(Tools::Vec3 {rnd()*len.x, rnd()*len.y,
+                                            rnd()*len.z});
+        }
+
+        CenterGrid grid;
+        grid.build(centers, len);
+
+        const int types[2] = {1, 2};
+
+        for (int id=0; id<6; id++) {
+            Voronoi::Cell cell = Voronoi::computeCell(centers, grid, id);
+            Tools::Mat3 R = Tools::rodrigues(rnd()*6, Tools::Vec3 {rnd(), rnd(),
+                                                                    rnd()});
+
+            // Reference: every site of a block covering the whole box
+            Atoms ref;
+            int m = 8;
+
+            for (int k=-m; k<=m; k++)
+            for (int j=-m; j<=m; j++)
+            for (int i=-m; i<=m; i++)
+            for (int s=0; s<Lattice::B1::nSites; s++) {
+                const Lattice::Site &site = Lattice::B1::sites[s];
+                Tools::Vec3 u = {site.x+i, site.y+j, site.z+k};
+                Tools::Vec3 d = R*(u*latConst);
+                Tools::Vec3 p = centers[id] + d;
+                Tools::Vec3 mi = Tools::minImage(d, box);
+
+                if (grid.nearest(p) == id && mi.x == d.x && mi.y == d.y &&
+                        mi.z == d.z) {
+                    p = Tools::wrap(p, box);
+                    ref.push_back(types[site.sub], p.x, p.y, p.z, id);
+                }
+            }
+
+            Atoms inside;
+            Atoms edge;
+            Grain::genGrainInCell<Lattice::B1>(inside, edge, cell, latConst,
+                                                types, R, box);
+
+            vector<int> owner(edge.size());
+            Classify::nearest(edge.view(), grid, owner.data());
+
+            // Same filter as Grain::keepOwnCell
+            Atoms kept;
+            for (size_t a=0; a<edge.size(); a++) {
+                Tools::Vec3 d = {edge.x[a]-centers[id].x,
+                                    edge.y[a]-centers[id].y,
+                                    edge.z[a]-centers[id].z};
+                Tools::Vec3 mi = Tools::minImage(d, box);
+
+                if (owner[a] == id && mi.x == d.x && mi.y == d.y &&
+                        mi.z == d.z) {
+                    Tools::Vec3 p = Tools::wrap(centers[id] + d, box);
+                    kept.push_back(edge.type[a], p.x, p.y, p.z, id);
+                }
+            }
+
+            inside.append(kept.view());
+
+            vector<Tools::Vec3> expected = sorted(ref.view());
+            vector<Tools::Vec3> found = sorted(inside.view());
+
+            CHECK_EQUAL(expected.size(), found.size());
+            CHECK_EQUAL(count(ref.type.begin(), ref.type.end(), 2),
+                        count(inside.type.begin(), inside.type.end(), 2));
+
+            for (size_t a=0; a<min(expected.size(), found.size()); a++) {
+                CHECK_CLOSE(0, Tools::norm2(expected[a] - found[a]), 1e-16);
+            }
+        }
+    }
+
+    TEST(onePassMatchesSublattices) {
+        srand(4);
+
+        Tools::Vec3 len = {15,15,15};
+        Tools::Box box = {Tools::Vec3 {0,0,0}, len, 0, 0, 0};
+        double latConst = 2.5;
+
+        vector<Tools::Vec3> centers;
+
+        for (int c=0; c<4; c++) {
+            centers.push_back(Tools::Vec3 {rnd()*len.x, rnd()*len.y,
+                                            rnd()*len.z});
+        }
+
+        vector<Voronoi::Cell> cells = Voronoi::computeCells(centers, len);
+
+        const int types[2] = {1, 2};
+        const int cation[1] = {1};
+        const int anion[1] = {2};
+
+        for (int id=0; id<4; id++) {
+            Tools::Mat3 R = Tools::rodrigues(rnd()*6, Tools::Vec3 {rnd(), rnd(),
+                                                                    rnd()});
+
+            // One pass over both sublattices against one call per sublattice
+            Atoms inside, edge;
+            Grain::genGrainInCell<Lattice::B1>(inside, edge, cells[id],
+                                                latConst, types, R, box);
+
+            Atoms inside2, edge2;
+            Grain::genGrainInCell<B1Cation>(inside2, edge2, cells[id],
+                                            latConst, cation, R, box);
+            Grain::genGrainInCell<B1Anion>(inside2, edge2, cells[id],
+                                            latConst, anion, R, box);
+
+            CHECK_EQUAL(inside2.size(), inside.size());
+            CHECK_EQUAL(edge2.size(), edge.size());
+            CHECK_EQUAL(count(inside2.type.begin(), inside2.type.end(), 2),
+                        count(inside.type.begin(), inside.type.end(), 2));
+
+            vector<Tools::Vec3> expected = sorted(inside2.view());
+            vector<Tools::Vec3> found = sorted(inside.view());
+
+            for (size_t a=0; a<min(expected.size(), found.size()); a++) {
+                CHECK_CLOSE(0, Tools::norm2(expected[a] - found[a]), 1e-16);
+            }
+        }
+    }
+}
+
+SUITE(lattices) {
+    TEST(siteCountsAndSpacing) {
+        checkLattice<Lattice::FCC>(sqrt(0.5));
+        checkLattice<Lattice::BCC>(sqrt(0.75));
+        checkLattice<Lattice::HCP>(1.0);
+        checkLattice<Lattice::Diamond>(sqrt(3.0)/4);
+        checkLattice<Lattice::B1>(0.5);
+        checkLattice<Lattice::B2>(sqrt(0.75));
+        checkLattice<Lattice::L12>(sqrt(0.5));
+    }
+
+    TEST(typesPerSublattice) {
+        const int types[2] = {3, 7};
+        Atoms atoms = fillBox<Lattice::L12>(2, 3.0, types);
+
+        int n3 = count(atoms.type.begin(), atoms.type.end(), 3);
+        int n7 = count(atoms.type.begin(), atoms.type.end(), 7);
+
+        CHECK_EQUAL(24, n3);
+        CHECK_EQUAL(8, n7);
+    }
+
+    TEST(expectedSites) {
+        CHECK_EQUAL(4000u, Grain::expectedSites<Lattice::FCC>(1000, 1.0));
+        CHECK_EQUAL(0u, Grain::expectedSites<Lattice::FCC>(1000, -1.0));
+        CHECK_EQUAL(0u, Grain::expectedSites<Lattice::FCC>(-8, 1.0));
+    }
+}
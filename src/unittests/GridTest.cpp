@@ -0,0 +1,96 @@
+#include "UnitTest++/UnitTest++.h"
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#include "define.h"
+#include "Tools.h"
+#include "Grid.h"
+#include "TestTools.h"
+
+const double tolerance = 1e-10;
+
+using namespace std;
+using TestTools::rnd;
+
+namespace {
+
+    int bruteNearest(Tools::Vec3 p, const vector<Tools::Vec3> &centers,
+                        Tools::Vec3 box) {
+        /* Closest center over all 27 images, ties to the lower id */
+
+        double best = 1e300;
+        int closest = -1;
+
+        for (size_t c=0; c<centers.size(); c++) {
+            for (int i=-1; i<2; i++) {
+                for (int j=-1; j<2; j++) {
+                    for (int k=-1; k<2; k++) {
+                        Tools::Vec3 img = centers[c] +
+                            Tools::Vec3 {i*box.x, j*box.y, k*box.z};
+                        double d2 = Tools::norm2(img - p);
+
+                        if (d2 < best) {
+                            best = d2;
+                            closest = static_cast<int>(c);
+                        }
+                    }
+                }
+            }
+        }
+
+        return closest;
+    }
+
+}
+
+SUITE(centerGrid) {
+    TEST(twoCenters) {
+        vector<Tools::Vec3> centers;
+
+        centers.push_back(Tools::Vec3 {1,5,5});
+        centers.push_back(Tools::Vec3 {6,5,5});
+
+        CenterGrid grid;
+        grid.build(centers, Tools::Vec3 {10,10,10});
+
+        CHECK_EQUAL(0, grid.nearest(Tools::Vec3 {2,5,5}));
+        CHECK_EQUAL(1, grid.nearest(Tools::Vec3 {5,5,5}));
+
+        // Across the periodic boundary 9.5 is closer to 1 than to 6
+        CHECK_EQUAL(0, grid.nearest(Tools::Vec3 {9.5,5,5}));
+    }
+
+    TEST(reportsDistance) {
+        vector<Tools::Vec3> centers;
+
+        centers.push_back(Tools::Vec3 {0.5,0.5,0.5});
+
+        CenterGrid grid;
+        grid.build(centers, Tools::Vec3 {4,4,4});
+
+        double d2;
+        CHECK_EQUAL(0, grid.nearest(Tools::Vec3 {3.5,0.5,0.5}, d2));
+        CHECK_CLOSE(1.0, d2, tolerance);
+    }
+
+    TEST(matchesBruteForce) {
+        srand(7);
+
+        Tools::Vec3 box = {30,20,25};
+        vector<Tools::Vec3> centers;
+
+        for (int c=0; c<200; c++) {
+            centers.push_back(Tools::Vec3 {rnd()*box.x, rnd()*box.y,
+                                            rnd()*box.z});
+        }
+
+        CenterGrid grid;
+        grid.build(centers, box);
+
+        for (int n=0; n<2000; n++) {
+            Tools::Vec3 p = {rnd()*box.x, rnd()*box.y, rnd()*box.z};
+
+            CHECK_EQUAL(bruteNearest(p, centers, box), grid.nearest(p));
+        }
+    }
+}
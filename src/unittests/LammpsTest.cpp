@@ -0,0 +1,407 @@
+#include "UnitTest++/UnitTest++.h"
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <stdexcept>
+#include <cstdlib>
+#include <cmath>
+#include <zlib.h>
+#include "define.h"
+#include "Atoms.h"
+#include "Tools.h"
+#include "Lammps.h"
+#include "TestTools.h"
+
+using namespace std;
+using TestTools::rnd;
+
+namespace {
+
+    vector<string> readLines(const string &filename) {
+        ifstream in(filename.c_str());
+        vector<string> lines;
+        string line;
+
+        while (getline(in, line))
+            lines.push_back(line);
+
+        return lines;
+    }
+
+    string readFile(const string &filename) {
+        ifstream in(filename.c_str());
+        stringstream text;
+        text << in.rdbuf();
+
+        return text.str();
+    }
+
+    string gunzip(const string &filename) {
+        /* Whole decompressed text, across all gzip members */
+
+        gzFile in = gzopen(filename.c_str(), "r");
+        string text;
+        char buf[1 << 16];
+        int n;
+
+        while ((n = gzread(in, buf, sizeof(buf))) > 0)
+            text.append(buf, n);
+
+        gzclose(in);
+
+        return text;
+    }
+}
+
+SUITE(writer) {
+    TEST(chunksAndPatchedHeader) {
+        string filename = "writerTest.data";
+
+        Atoms a;
+        a.push_back(1, 0.5, 1.5, 2.5);
+        a.push_back(3, 1.0, 2.0, 3.0);
+
+        Atoms b;
+        b.push_back(2, 4.0, 5.0, 6.0);
+
+        Tools::Box box = {Tools::Vec3 {-1,0,2}, Tools::Vec3 {10,20,30}, 0, 0, 0};
+
+        Lammps::Writer writer;
+        writer.open(filename, box);
+        writer.write(a.view());
+        writer.write(b.view());
+        writer.close();
+
+        vector<string> lines = readLines(filename);
+        remove(filename.c_str());
+
+        CHECK_EQUAL(14u, lines.size());
+
+        // Counts are patched in place; numbers are padded, not shifted
+        int nAtoms = 0, nTypes = 0;
+        string word;
+
+        istringstream(lines[2]) >> nAtoms >> word;
+        CHECK_EQUAL(3, nAtoms);
+        CHECK_EQUAL("atoms", word);
+
+        istringstream(lines[3]) >> nTypes;
+        CHECK_EQUAL(3, nTypes);
+
+        // Bounds come from the box, not the atoms
+        CHECK_EQUAL("-1.000000 9.000000 xlo xhi", lines[5]);
+        CHECK_EQUAL("2.000000 32.000000 zlo zhi", lines[7]);
+
+        CHECK_EQUAL("1 1 0.500000 1.500000 2.500000", lines[11]);
+        CHECK_EQUAL("3 2 4.000000 5.000000 6.000000", lines[13]);
+    }
+
+    TEST(triclinicTilts) {
+        string filename = "writerTest.data";
+
+        Tools::Box box = {Tools::Vec3 {0,0,0}, Tools::Vec3 {1,1,1}, 0.5, 0,
+                            0};
+
+        Lammps::Writer writer;
+        writer.open(filename, box);
+        writer.close();
+
+        vector<string> lines = readLines(filename);
+        remove(filename.c_str());
+
+        CHECK_EQUAL("0.500000 0.000000 0.000000 xy xz yz", lines[8]);
+    }
+
+    TEST(badPath) {
+        Tools::Box box = {Tools::Vec3 {0,0,0}, Tools::Vec3 {1,1,1}, 0, 0, 0};
+        Lammps::Writer writer;
+
+        CHECK_THROW(writer.open("no/such/dir/out.data", box), runtime_error);
+    }
+}
+
+SUITE(format) {
+    TEST(matchesPrintf) {
+        Atoms atoms;
+        atoms.push_back(1, -0.0, -1e-9, 0.5e-6);
+        atoms.push_back(2, 2.5e-6, 123456.0000005, -3.0000004999999);
+        atoms.push_back(7, 1e15, -250.125, 0.1);
+
+        srand(3);
+
+        for (int i=0; i<1000; i++) {
+            atoms.push_back(rand() % 5, (rnd() - 0.5)*2e5,
+                            rnd()*200, -rnd()*2e6);
+        }
+
+        for (int precision=0; precision<=9; precision+=3) {
+            string text;
+            Lammps::formatAtoms(text, atoms.view(), 41, precision);
+
+            string expected;
+            char line[256];
+
+            for (size_t i=0; i<atoms.size(); i++) {
+                snprintf(line, sizeof(line), "%zu %d %.*f %.*f %.*f\n", 41+i,
+                            atoms.type[i], precision, atoms.x[i], precision,
+                            atoms.y[i], precision, atoms.z[i]);
+                expected += line;
+            }
+
+            CHECK(expected == text);
+        }
+    }
+
+    TEST(hugeCoordinates) {
+        Atoms atoms;
+        atoms.push_back(1, 1e300, -1e200, 1);
+
+        string text;
+        Lammps::formatAtoms(text, atoms.view(), 1, 2);
+
+        char line[1024];
+        snprintf(line, sizeof(line), "1 1 %.2f %.2f 1.00\n", 1e300, -1e200);
+
+        CHECK(text == line);
+    }
+
+    TEST(parallelBlocksMatchSerial) {
+        Atoms atoms;
+        srand(5);
+
+        // Several formatting blocks, the last one partial
+        for (int i=0; i<150000; i++)
+            atoms.push_back(1 + i%3, rnd()*2000, rnd()*2000, rnd()*2000);
+
+        Tools::Box box = {Tools::Vec3 {0,0,0}, Tools::Vec3 {9,9,9}, 0, 0, 0};
+
+        Lammps::Writer serial;
+        serial.open("serialTest.data", box, 5, 1);
+        serial.write(atoms.view(1, 10));
+        serial.write(atoms.view(11, atoms.size()-11));
+        serial.close();
+
+        Lammps::Writer parallel;
+        parallel.open("parallelTest.data", box, 5, 3);
+        parallel.write(atoms.view(1, 10));
+        parallel.write(atoms.view(11, atoms.size()-11));
+        parallel.close();
+
+        string a = readFile("serialTest.data");
+        string b = readFile("parallelTest.data");
+
+        remove("serialTest.data");
+        remove("parallelTest.data");
+
+        CHECK_EQUAL(a.size(), b.size());
+        CHECK(a == b);
+
+        // Ids run on across chunks
+        CHECK(b.find("\n149999 ") != string::npos);
+        CHECK(b.find("\n150000 ") == string::npos);
+    }
+
+    TEST(commentValues) {
+        Atoms atoms;
+
+        for (int i=0; i<70000; i++)
+            atoms.push_back(1 + i%2, i*1e-3, 0.5, -0.25);
+
+        Tools::Box box = {Tools::Vec3 {0,0,0}, Tools::Vec3 {70,1,1}, 0, 0, 0};
+
+        Lammps::Writer writer;
+        writer.comment = [](const AtomView &arr, double *out) {
+            for (size_t i=0; i<arr.size(); i++)
+                out[i] = 2*arr.x[i];
+        };
+        writer.commentName = "twice x";
+        writer.commentDigits = 2;
+        writer.open("commentTest.data", box, 3, 2);
+        writer.write(atoms.view(0, 5));
+        writer.write(atoms.view(5, atoms.size()-5));
+        writer.close();
+
+        vector<string> lines = readLines("commentTest.data");
+        CHECK(lines[0].find("after each atom: twice x") != string::npos);
+        CHECK_EQUAL("1 1 0.000 0.500 -0.250 # 0.00", lines[11]);
+        CHECK_EQUAL("70000 2 69.999 0.500 -0.250 # 140.00", lines.back());
+
+        // Still an 'atomic' file to the reader
+        Lammps::Data data;
+        Lammps::readData("commentTest.data", data, 2);
+        remove("commentTest.data");
+
+        CHECK_EQUAL("atomic", data.style);
+        CHECK_EQUAL(atoms.size(), data.atoms.size());
+        CHECK_CLOSE(69.999, data.atoms.x[atoms.size()-1], 1e-12);
+    }
+}
+
+SUITE(gzip) {
+    TEST(matchesPlain) {
+        Atoms atoms;
+        srand(8);
+
+        // Enough text for several compressed blocks per thread
+        for (int i=0; i<200000; i++)
+            atoms.push_back(1 + i%2, rnd()*2000, rnd()*2000, rnd()*2000);
+
+        Tools::Box box = {Tools::Vec3 {0,0,0}, Tools::Vec3 {9,9,9}, 0, 0, 0};
+
+        Lammps::writeData("plainTest.data", atoms.view(), box, 6, 2);
+
+        // By name, in small and large chunks
+        Lammps::Writer writer;
+        writer.open("gzipTest.data.gz", box, 6, 2);
+        CHECK(writer.gzip);
+
+        writer.write(atoms.view(0, 7));
+        writer.write(atoms.view(7, atoms.size()-7));
+        writer.close();
+
+        string plain = readFile("plainTest.data");
+        string packed = readFile("gzipTest.data.gz");
+
+        CHECK(packed.size() < plain.size()/2);
+        CHECK(plain == gunzip("gzipTest.data.gz"));
+
+        // Formatted elsewhere, and forced on by option
+        string text;
+        Lammps::formatAtoms(text, atoms.view(), 1, 6);
+
+        writer.open("gzipTest.data", box, 6, 3, Lammps::GZIP);
+        writer.append(text, atoms.size(), 2);
+        writer.close();
+
+        CHECK(plain == gunzip("gzipTest.data"));
+
+        remove("plainTest.data");
+        remove("gzipTest.data.gz");
+        remove("gzipTest.data");
+    }
+
+    TEST(emptyFile) {
+        Tools::Box box = {Tools::Vec3 {0,0,0}, Tools::Vec3 {1,1,1}, 0, 0, 0};
+
+        Lammps::Writer writer;
+        writer.open("emptyTest.data.gz", box);
+        writer.close();
+
+        string text = gunzip("emptyTest.data.gz");
+        remove("emptyTest.data.gz");
+
+        CHECK(text.find("\n                   0 atoms\n") != string::npos);
+        CHECK(text.find("Atoms # 'atomic'\n\n") != string::npos);
+    }
+}
+
+SUITE(reader) {
+    TEST(roundTrip) {
+        Atoms atoms;
+        srand(3);
+
+        for (int i=0; i<300000; i++)
+            atoms.push_back(1 + i%4, rnd()*2000, -rnd()*2000, rnd()*200);
+
+        Tools::Box box = {Tools::Vec3 {-1,2,3}, Tools::Vec3 {4,5,6}, 0.5, 0,
+                            -0.25};
+
+        Lammps::writeData("readTest.data", atoms.view(), box, 8, 2);
+
+        for (int threads=1; threads<=4; threads*=2) {
+            Lammps::Data data;
+            Lammps::readData("readTest.data", data, threads);
+
+            CHECK_EQUAL("atomic", data.style);
+            CHECK_EQUAL(4, data.nTypes);
+            CHECK_EQUAL(atoms.size(), data.atoms.size());
+            CHECK_EQUAL(0u, data.charge.size());
+            CHECK_CLOSE(-1, data.box.lo.x, 1e-12);
+            CHECK_CLOSE(6, data.box.len.z, 1e-12);
+            CHECK_CLOSE(0.5, data.box.xy, 1e-12);
+            CHECK_CLOSE(-0.25, data.box.yz, 1e-12);
+
+            int wrong = 0;
+
+            for (size_t a=0; a<atoms.size(); a++) {
+                wrong += (data.id[a] != a+1);
+                wrong += (data.atoms.type[a] != atoms.type[a]);
+                wrong += (data.atoms.grain[a] != -1);
+                wrong += (fabs(data.atoms.x[a] - atoms.x[a]) > 1e-8);
+                wrong += (fabs(data.atoms.y[a] - atoms.y[a]) > 1e-8);
+                wrong += (fabs(data.atoms.z[a] - atoms.z[a]) > 1e-8);
+            }
+
+            CHECK_EQUAL(0, wrong);
+        }
+
+        remove("readTest.data");
+    }
+
+    TEST(chargeStyleAndSections) {
+        string filename = "chargeTest.data";
+
+        FILE *file = fopen(filename.c_str(), "w");
+        fprintf(file, "Written by hand\n\n"
+                        "3 atoms   # comment\n"
+                        "2 atom types\n"
+                        "0 10 xlo xhi\n0 10 ylo yhi\n0 10 zlo zhi\n\n"
+                        "Masses\n\n1 22.99\n2 35.45\n\n"
+                        "Atoms\n\n"
+                        "7 1 +1.0 0.5 0.5 0.5 0 0 1\n"
+                        "\n"
+                        "3 2 -1.0 1e-3 2.25 -3 0 0 0\n"
+                        "  5\t1 1.0 9 9 9 1 0 0 # last\n\n"
+                        "Velocities\n\n7 0 0 0\n3 0 0 0\n5 0 0 0\n");
+        fclose(file);
+
+        Lammps::Data data;
+        Lammps::readData(filename, data, 3);
+        remove(filename.c_str());
+
+        CHECK_EQUAL("charge", data.style);
+        CHECK_EQUAL(3u, data.atoms.size());
+        CHECK_EQUAL(3u, data.charge.size());
+
+        CHECK_EQUAL(7u, data.id[0]);
+        CHECK_EQUAL(3u, data.id[1]);
+        CHECK_EQUAL(5u, data.id[2]);
+        CHECK_EQUAL(2, data.atoms.type[1]);
+        CHECK_CLOSE(-1.0, data.charge[1], 1e-12);
+        CHECK_CLOSE(1e-3, data.atoms.x[1], 1e-15);
+        CHECK_CLOSE(-3.0, data.atoms.z[1], 1e-12);
+        CHECK_CLOSE(9.0, data.atoms.y[2], 1e-12);
+        CHECK_CLOSE(10.0, data.box.len.x, 1e-12);
+    }
+
+    TEST(badFiles) {
+        string filename = "badTest.data";
+
+        FILE *file = fopen(filename.c_str(), "w");
+        fprintf(file, "Title\n\n2 atoms\n1 atom types\n\nAtoms # atomic\n\n"
+                        "1 1 0 0 0\n");
+        fclose(file);
+
+        Lammps::Data data;
+        CHECK_THROW(Lammps::readData(filename, data), runtime_error);
+
+        file = fopen(filename.c_str(), "w");
+        fprintf(file, "Title\n\n1 atoms\n1 atom types\n\nAtoms # atomic\n\n"
+                        "1 1 0 x 0\n");
+        fclose(file);
+
+        CHECK_THROW(Lammps::readData(filename, data), runtime_error);
+
+        file = fopen(filename.c_str(), "w");
+        fprintf(file, "Title\n\n1 atoms\n1 atom types\n\nAtoms # full\n\n"
+                        "1 1 1 0 0 0 0\n");
+        fclose(file);
+
+        CHECK_THROW(Lammps::readData(filename, data), runtime_error);
+        remove(filename.c_str());
+
+        CHECK_THROW(Lammps::readData("noSuchFile.data", data), runtime_error);
+    }
+}
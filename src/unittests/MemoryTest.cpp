@@ -0,0 +1,39 @@
+#include "UnitTest++/UnitTest++.h"
+#include <vector>
+#include "Memory.h"
+
+using namespace std;
+
+SUITE(usage) {
+    TEST(countsAllocations) {
+        Memory::Usage before = Memory::usage();
+
+        vector<double> *v = new vector<double>(1000);
+        delete v;
+
+        Memory::Usage after = Memory::usage();
+
+        CHECK_EQUAL(before.allocations + 2, after.allocations);
+        CHECK(after.bytes - before.bytes >= 1000*sizeof(double));
+    }
+
+    TEST(reusedCapacityDoesNotAllocate) {
+        vector<int> v;
+        v.reserve(64);
+
+        Memory::Usage before = Memory::usage();
+
+        for (int round=0; round<10; round++) {
+            v.clear();
+
+            for (int i=0; i<64; i++)
+                v.push_back(i);
+        }
+
+        CHECK_EQUAL(before.allocations, Memory::usage().allocations);
+    }
+
+    TEST(peakRss) {
+        CHECK(Memory::usage().peakRss > 0);
+    }
+}
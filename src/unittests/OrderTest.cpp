@@ -0,0 +1,152 @@
+#include "UnitTest++/UnitTest++.h"
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include "Atoms.h"
+#include "Tools.h"
+#include "Order.h"
+#include "TestTools.h"
+
+using namespace std;
+using TestTools::rnd;
+
+namespace {
+
+    uint64_t rnd21() {
+        return static_cast<uint64_t>(rnd()*((1 << 21) - 1));
+    }
+
+    uint64_t rnd64() {
+        return (rnd21() << 42) ^ (rnd21() << 21) ^ rnd21();
+    }
+}
+
+SUITE(curves) {
+    TEST(mortonInterleaves) {
+        CHECK_EQUAL(1u, Order::morton(1, 0, 0));
+        CHECK_EQUAL(2u, Order::morton(0, 1, 0));
+        CHECK_EQUAL(4u, Order::morton(0, 0, 1));
+        CHECK_EQUAL(63u, Order::morton(3, 3, 3));
+        CHECK_EQUAL((static_cast<uint64_t>(1) << 63) - 1,
+                    Order::morton(0x1fffff, 0x1fffff, 0x1fffff));
+    }
+
+    TEST(hilbertVisitsNeighbors) {
+        // The coarse 8^3 grid, as the top bits of the fine one
+        int m = 8;
+        int shift = Order::BITS - 3;
+
+        vector<pair<uint64_t, int> > cells;
+
+        for (int i=0; i<m*m*m; i++) {
+            uint32_t x = i%m, y = (i/m)%m, z = i/(m*m);
+            cells.push_back(make_pair(Order::hilbert(x << shift, y << shift,
+                                                        z << shift), i));
+        }
+
+        sort(cells.begin(), cells.end());
+
+        int jumps = 0;
+
+        for (size_t c=1; c<cells.size(); c++) {
+            int a = cells[c-1].second;
+            int b = cells[c].second;
+
+            int step = abs(a%m - b%m) + abs((a/m)%m - (b/m)%m) +
+                        abs(a/(m*m) - b/(m*m));
+            jumps += (step != 1);
+
+            // Keys are distinct
+            jumps += (cells[c-1].first == cells[c].first);
+        }
+
+        CHECK_EQUAL(0, jumps);
+        CHECK_EQUAL(0u, Order::hilbert(0, 0, 0));
+    }
+}
+
+SUITE(radixSort) {
+    TEST(stableLikeStdSort) {
+        srand(6);
+
+        for (int threads=1; threads<=4; threads++) {
+            size_t n = 50000;
+            vector<uint64_t> key(n);
+            vector<uint32_t> order(n);
+
+            // Narrow keys repeat, so stability matters
+            for (size_t i=0; i<n; i++) {
+                key[i] = (i%2) ? rnd64() >> 1 : rnd64() % 97;
+                order[i] = i;
+            }
+
+            vector<pair<uint64_t, uint32_t> > expected(n);
+
+            for (size_t i=0; i<n; i++)
+                expected[i] = make_pair(key[i], order[i]);
+
+            stable_sort(expected.begin(), expected.end(),
+                [](const pair<uint64_t, uint32_t> &a,
+                    const pair<uint64_t, uint32_t> &b) {
+                    return a.first < b.first;
+                });
+
+            Order::radixSort(key, order, threads);
+
+            int wrong = 0;
+
+            for (size_t i=0; i<n; i++) {
+                wrong += (key[i] != expected[i].first);
+                wrong += (order[i] != expected[i].second);
+            }
+
+            CHECK_EQUAL(0, wrong);
+        }
+    }
+}
+
+SUITE(sortAtoms) {
+    TEST(keysAscendAndAtomsKept) {
+        srand(10);
+
+        Tools::Box box = {Tools::Vec3 {-2,0,1}, Tools::Vec3 {10,12,8}, 1.5,
+                            0, -2};
+
+        Atoms atoms;
+
+        for (int i=0; i<20000; i++) {
+            atoms.push_back(i%5, -2 + rnd()*20, rnd()*24,
+                            1 + rnd()*16, i);
+        }
+
+        Atoms sorted = atoms;
+        Order::sort(sorted, box, Order::HILBERT, 3);
+
+        CHECK_EQUAL(atoms.size(), sorted.size());
+
+        // Sorted at least down to cells of a 16^3 grid, whose keys are the
+        // top bits of the full ones
+        vector<uint64_t> key(sorted.size());
+        Order::keys(sorted.view(), box, Order::HILBERT, key.data());
+
+        for (size_t a=0; a<key.size(); a++)
+            key[a] >>= 3*(Order::BITS - 4);
+
+        CHECK(is_sorted(key.begin(), key.end()));
+
+        // Every atom is still there once, with its own data
+        int wrong = 0;
+
+        for (size_t a=0; a<sorted.size(); a++) {
+            int i = sorted.grain[a];
+            wrong += (sorted.x[a] != atoms.x[i]);
+            wrong += (sorted.type[a] != atoms.type[i]);
+        }
+
+        sort(sorted.grain.begin(), sorted.grain.end());
+        wrong += (sorted.grain != atoms.grain);
+
+        CHECK_EQUAL(0, wrong);
+    }
+}
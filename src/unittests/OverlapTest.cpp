@@ -0,0 +1,149 @@
+#include "UnitTest++/UnitTest++.h"
+#include <vector>
+#include <cstdlib>
+#include <stdexcept>
+#include <map>
+#include <utility>
+#include <algorithm>
+#include "Atoms.h"
+#include "Tools.h"
+#include "Overlap.h"
+#include "TestTools.h"
+
+using namespace std;
+using TestTools::rnd;
+
+namespace {
+
+    vector<char> greedy(const Atoms &atoms, const Tools::Box &box,
+                        double cutoff, Overlap::Policy policy) {
+        /* Reference: visit atoms best ranked first, keeping each one that
+         * is not too close to an atom already kept */
+
+        vector<size_t> rank(atoms.size());
+
+        for (size_t i=0; i<rank.size(); i++)
+            rank[i] = i;
+
+        stable_sort(rank.begin(), rank.end(), [&](size_t a, size_t b) {
+            if (policy == Overlap::LOWER_GRAIN)
+                return atoms.grain[a] < atoms.grain[b];
+            if (policy == Overlap::HIGHER_GRAIN)
+                return atoms.grain[a] > atoms.grain[b];
+            return false;
+        });
+
+        vector<char> kept(atoms.size(), 0);
+        vector<size_t> keep;
+
+        for (size_t r=0; r<rank.size(); r++) {
+            size_t i = rank[r];
+            bool clear = true;
+
+            for (size_t k=0; k<keep.size() && clear; k++) {
+                size_t j = keep[k];
+                Tools::Vec3 d = {atoms.x[i]-atoms.x[j], atoms.y[i]-atoms.y[j],
+                                    atoms.z[i]-atoms.z[j]};
+                clear = Tools::norm2(Tools::minImage(d, box)) >= cutoff*cutoff;
+            }
+
+            if (clear) {
+                kept[i] = 1;
+                keep.push_back(i);
+            }
+        }
+
+        return kept;
+    }
+}
+
+SUITE(overlap) {
+    TEST(matchesGreedyRemoval) {
+        srand(21);
+
+        Tools::Box box = {Tools::Vec3 {1,-2,0}, Tools::Vec3 {10,9,8}, 1.0,
+                            -0.5, 0.75};
+        Atoms atoms;
+
+        // Dense enough for chains of close atoms
+        for (int i=0; i<1500; i++) {
+            Tools::Vec3 p = Tools::wrap(Tools::Vec3 {rnd()*12, rnd()*12,
+                                                        rnd()*12}, box);
+            atoms.push_back(1, p.x, p.y, p.z, rand()%6);
+        }
+
+        Overlap::Policy policies[3] = {Overlap::FIRST, Overlap::LOWER_GRAIN,
+                                        Overlap::HIGHER_GRAIN};
+        double cutoff = 0.9;
+
+        for (int p=0; p<3; p++) {
+            vector<char> kept = greedy(atoms, box, cutoff, policies[p]);
+            Atoms expected;
+
+            for (size_t i=0; i<atoms.size(); i++) {
+                if (kept[i])
+                    expected.push_back(atoms.type[i], atoms.x[i], atoms.y[i],
+                                        atoms.z[i], atoms.grain[i]);
+            }
+
+            for (int threads=1; threads<=4; threads+=3) {
+                Atoms thinned = atoms;
+                Overlap::Report report = Overlap::removeClose(thinned, box,
+                                            cutoff, policies[p], threads);
+
+                CHECK_EQUAL(atoms.size() - expected.size(), report.removed);
+                CHECK(expected.x == thinned.x);
+                CHECK(expected.grain == thinned.grain);
+
+                size_t pairs = 0;
+                size_t removed = 0;
+                map<pair<int, int>, Overlap::Count>::const_iterator g;
+
+                for (g=report.grains.begin(); g!=report.grains.end(); g++) {
+                    CHECK(g->first.first <= g->first.second);
+                    pairs += g->second.pairs;
+                    removed += g->second.removed;
+                }
+
+                CHECK_EQUAL(report.pairs, pairs);
+                CHECK_EQUAL(report.removed, removed);
+            }
+        }
+    }
+
+    TEST(duplicatesAcrossFaces) {
+        // Grain 0 on a 4^3 grid; grain 1 repeats its x=0 face at x=L,
+        // the same sites through the periodic boundary
+        Tools::Box box = {Tools::Vec3 {0,0,0}, Tools::Vec3 {8,8,8}, 0, 0, 0};
+        Atoms atoms;
+
+        for (int k=0; k<4; k++)
+        for (int j=0; j<4; j++)
+        for (int i=0; i<4; i++)
+            atoms.push_back(1, 2*i, 2*j, 2*k, 0);
+
+        for (int k=0; k<4; k++)
+        for (int j=0; j<4; j++)
+            atoms.push_back(1, 8, 2*j, 2*k, 1);
+
+        Overlap::Report report = Overlap::removeClose(atoms, box, 0.5,
+                                                    Overlap::HIGHER_GRAIN);
+
+        CHECK_EQUAL(16u, report.pairs);
+        CHECK_EQUAL(16u, report.removed);
+        CHECK_EQUAL(64u, atoms.size());
+        CHECK_EQUAL(16u, report.grains[make_pair(0, 1)].removed);
+        CHECK_EQUAL(16, count(atoms.grain.begin(), atoms.grain.end(), 1));
+    }
+
+    TEST(badCutoff) {
+        Tools::Box box = {Tools::Vec3 {0,0,0}, Tools::Vec3 {4,4,4}, 0, 0, 0};
+        Atoms atoms;
+        atoms.push_back(1, 0, 0, 0, 0);
+
+        CHECK_THROW(Overlap::removeClose(atoms, box, 2.5, Overlap::FIRST),
+                    invalid_argument);
+        CHECK_THROW(Overlap::removeClose(atoms, box, 0, Overlap::FIRST),
+                    invalid_argument);
+    }
+}
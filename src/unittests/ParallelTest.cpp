@@ -0,0 +1,182 @@
+#include "UnitTest++/UnitTest++.h"
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <stdexcept>
+#include "Parallel.h"
+
+using namespace std;
+
+SUITE(forEach) {
+    TEST(everyItemOnce) {
+        int n = 1000;
+
+        for (int threads=1; threads<=8; threads*=2) {
+            vector<atomic<int> > hits(n);
+            atomic<int> badThread(0);
+
+            for (int i=0; i<n; i++)
+                hits[i] = 0;
+
+            Parallel::forEach(n, threads, [&](int i, int t) {
+                hits[i]++;
+
+                if (t < 0 || t >= threads)
+                    badThread++;
+            });
+
+            int wrong = 0;
+
+            for (int i=0; i<n; i++)
+                wrong += (hits[i] != 1);
+
+            CHECK_EQUAL(0, wrong);
+            CHECK_EQUAL(0, badThread.load());
+        }
+    }
+
+    TEST(noItems) {
+        int calls = 0;
+
+        Parallel::forEach(0, 4, [&](int, int) { calls++; });
+
+        CHECK_EQUAL(0, calls);
+    }
+
+    TEST(rethrows) {
+        CHECK_THROW(Parallel::forEach(100, 4, [](int i, int) {
+                        if (i == 37)
+                            throw runtime_error("item failed");
+                    }), runtime_error);
+    }
+}
+
+SUITE(forEachStealing) {
+    TEST(everyItemOnce) {
+        int n = 777;
+
+        for (int threads=1; threads<=8; threads*=2) {
+            vector<atomic<int> > hits(n);
+
+            for (int i=0; i<n; i++)
+                hits[i] = 0;
+
+            Parallel::Stats stats;
+
+            // Uneven work, heavy at the front, to make threads steal
+            Parallel::forEachStealing(n, threads, [&](int i, int) {
+                volatile double x = 0;
+
+                for (int k=0; k<(i < 50 ? 20000 : 10); k++)
+                    x += k;
+
+                hits[i]++;
+            }, &stats);
+
+            int wrong = 0;
+
+            for (int i=0; i<n; i++)
+                wrong += (hits[i] != 1);
+
+            int items = 0;
+
+            for (size_t t=0; t<stats.items.size(); t++)
+                items += stats.items[t];
+
+            CHECK_EQUAL(0, wrong);
+            CHECK_EQUAL(n, items);
+            CHECK_EQUAL(static_cast<size_t>(threads), stats.busy.size());
+            CHECK(stats.imbalance() >= 1.0);
+        }
+    }
+
+    TEST(rethrows) {
+        CHECK_THROW(Parallel::forEachStealing(100, 3, [](int i, int) {
+                        if (i == 99)
+                            throw runtime_error("item failed");
+                    }), runtime_error);
+    }
+}
+
+SUITE(inOrder) {
+    TEST(emitsInIndexOrder) {
+        int n = 500;
+
+        Parallel::InOrder order;
+        vector<int> seen;
+
+        order.reset(n, [&](int i) { seen.push_back(i); });
+
+        Parallel::forEach(n, 4, [&](int i, int) { order.done(i); });
+
+        CHECK_EQUAL(static_cast<size_t>(n), seen.size());
+
+        int wrong = 0;
+
+        for (int i=0; i<static_cast<int>(seen.size()); i++)
+            wrong += (seen[i] != i);
+
+        CHECK_EQUAL(0, wrong);
+    }
+
+    TEST(waitsForGap) {
+        Parallel::InOrder order;
+        vector<int> seen;
+
+        order.reset(3, [&](int i) { seen.push_back(i); });
+
+        order.done(2);
+        order.done(1);
+        CHECK_EQUAL(0u, seen.size());
+
+        order.done(0);
+        CHECK_EQUAL(3u, seen.size());
+    }
+}
+
+SUITE(boundedQueue) {
+    TEST(fifoWithinCapacity) {
+        Parallel::BoundedQueue<int> queue;
+        queue.reset(4);
+
+        int n = 2000;
+        vector<int> seen;
+
+        thread consumer([&]() {
+            int i;
+
+            while (queue.pop(i))
+                seen.push_back(i);
+        });
+
+        for (int i=0; i<n; i++)
+            queue.push(i);
+
+        queue.close();
+        consumer.join();
+
+        CHECK_EQUAL(static_cast<size_t>(n), seen.size());
+
+        int wrong = 0;
+
+        for (int i=0; i<static_cast<int>(seen.size()); i++)
+            wrong += (seen[i] != i);
+
+        CHECK_EQUAL(0, wrong);
+        CHECK(queue.longest <= 4u);
+        CHECK(queue.meanLength() >= 1.0);
+    }
+
+    TEST(closedAndDrained) {
+        Parallel::BoundedQueue<int> queue;
+        queue.reset(2);
+
+        queue.push(5);
+        queue.close();
+
+        int i = 0;
+        CHECK(queue.pop(i));
+        CHECK_EQUAL(5, i);
+        CHECK(!queue.pop(i));
+    }
+}
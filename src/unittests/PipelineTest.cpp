@@ -0,0 +1,89 @@
+#include "UnitTest++/UnitTest++.h"
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <stdexcept>
+#include "Atoms.h"
+#include "Tools.h"
+#include "Lammps.h"
+#include "Pipeline.h"
+
+using namespace std;
+
+namespace {
+
+    string readFile(const string &filename) {
+        ifstream in(filename.c_str());
+        stringstream text;
+        text << in.rdbuf();
+
+        return text.str();
+    }
+
+    // Chunk c holds c%7 atoms of type c%3+1, so some chunks are empty
+    void fill(int c, Atoms &out) {
+        for (int a=0; a<c%7; a++)
+            out.push_back(c%3 + 1, c + 0.125*a, -0.5*c, 1e3*a);
+    }
+}
+
+SUITE(pipeline) {
+    TEST(matchesSerialWriter) {
+        int n = 60;
+        Tools::Box box = {Tools::Vec3 {0,0,0}, Tools::Vec3 {9,9,9}, 0, 0, 0};
+
+        Lammps::Writer serial;
+        serial.open("pipelineSerial.data", box, 4);
+
+        for (int c=0; c<n; c++) {
+            Atoms chunk;
+            fill(c, chunk);
+            serial.write(chunk.view());
+        }
+
+        serial.close();
+
+        string expected = readFile("pipelineSerial.data");
+        remove("pipelineSerial.data");
+
+        // A window of one chunk runs the stages in lock step
+        int windows[3] = {1, 3, 64};
+
+        for (int w=0; w<3; w++) {
+            Lammps::Writer writer;
+            writer.open("pipelineTest.data", box, 4);
+
+            Pipeline::Report report = Pipeline::run(n, 4, 2, windows[w],
+                [](int c, int, Atoms &out) { fill(c, out); }, writer);
+
+            writer.close();
+
+            CHECK(expected == readFile("pipelineTest.data"));
+            remove("pipelineTest.data");
+
+            CHECK_EQUAL(4, report.generate.threads);
+            CHECK_EQUAL(1, report.write.threads);
+            CHECK(report.formatQueueMax <= static_cast<size_t>(windows[w]));
+            CHECK(report.writeQueueMax <= static_cast<size_t>(windows[w]));
+        }
+    }
+
+    TEST(rethrows) {
+        Tools::Box box = {Tools::Vec3 {0,0,0}, Tools::Vec3 {9,9,9}, 0, 0, 0};
+
+        Lammps::Writer writer;
+        writer.open("pipelineThrow.data", box);
+
+        CHECK_THROW(Pipeline::run(100, 3, 1, 2, [](int c, int, Atoms &out) {
+            if (c == 17)
+                throw runtime_error("bad chunk");
+
+            fill(c, out);
+        }, writer), runtime_error);
+
+        writer.close();
+        remove("pipelineThrow.data");
+    }
+}
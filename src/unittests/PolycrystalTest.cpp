@@ -0,0 +1,131 @@
+#include "UnitTest++/UnitTest++.h"
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include "Atoms.h"
+#include "Tools.h"
+#include "Lattice.h"
+#include "Random.h"
+#include "Polycrystal.h"
+#include "TestTools.h"
+
+using namespace std;
+using TestTools::rnd;
+
+namespace {
+
+    const double LAT_CONST = 3.6;
+    const int TYPES[Lattice::B1::nSub] = {1, 2};
+
+    void randomGrains(int n, Tools::Vec3 len, vector<Tools::Vec3> &centers,
+                        vector<Tools::Mat3> &rotations) {
+        centers.clear();
+        rotations.clear();
+
+        for (int g=0; g<n; g++) {
+            centers.push_back(Tools::Vec3 {rnd()*len.x, rnd()*len.y,
+                                            rnd()*len.z});
+
+            Random::Stream s = Random::stream(5, g, Random::ORIENTATION);
+            rotations.push_back(Random::orientation(s));
+        }
+    }
+
+    bool same(Atoms &a, Atoms &b) {
+        return a.x == b.x && a.y == b.y && a.z == b.z && a.type == b.type &&
+                a.grain == b.grain;
+    }
+
+    int mismatches(Polycrystal::Model &edited, Polycrystal::Model &fresh) {
+        /* Grains whose atoms differ from a model built from scratch */
+
+        int wrong = 0;
+
+        for (size_t g=0; g<fresh.grains.size(); g++)
+            wrong += !same(edited.grains[g], fresh.grains[g]);
+
+        return wrong;
+    }
+}
+
+SUITE(polycrystal) {
+    TEST(buildCoversBox) {
+        srand(2);
+
+        Tools::Vec3 len = {30, 30, 30};
+        vector<Tools::Vec3> centers;
+        vector<Tools::Mat3> rotations;
+        randomGrains(6, len, centers, rotations);
+
+        Polycrystal::Model model;
+        model.build(centers, rotations, len,
+                    Polycrystal::lattice<Lattice::B1>(LAT_CONST, TYPES), 2);
+
+        // Every site of the box once: 8 sites per cubic cell on average
+        double expected = 8*len.x*len.y*len.z /
+                            (LAT_CONST*LAT_CONST*LAT_CONST);
+
+        CHECK_CLOSE(1.0, model.size()/expected, 0.02);
+
+        vector<size_t> first = model.offsets();
+        CHECK_EQUAL(centers.size() + 1, first.size());
+        CHECK_EQUAL(model.size(), first.back());
+        CHECK_EQUAL(model.grains[2].size(), first[3] - first[2]);
+    }
+
+    TEST(moveMatchesRebuild) {
+        srand(8);
+
+        // Enough grains to use the grid, and for an edit to leave most of
+        // them alone
+        Tools::Vec3 len = {40, 40, 40};
+        vector<Tools::Vec3> centers;
+        vector<Tools::Mat3> rotations;
+        randomGrains(40, len, centers, rotations);
+
+        Polycrystal::Generator b1 =
+            Polycrystal::lattice<Lattice::B1>(LAT_CONST, TYPES);
+
+        Polycrystal::Model model;
+        model.build(centers, rotations, len, b1);
+
+        vector<int> changed = model.moveCenter(7, centers[7] +
+                                                Tools::Vec3 {3, -2, 41});
+
+        CHECK(changed.size() > 1);
+        CHECK(changed.size() < centers.size());
+        CHECK(binary_search(changed.begin(), changed.end(), 7));
+
+        Polycrystal::Model fresh;
+        fresh.build(model.centers, rotations, len, b1);
+
+        CHECK_EQUAL(0, mismatches(model, fresh));
+        CHECK_EQUAL(fresh.size(), model.size());
+    }
+
+    TEST(rotateMatchesRebuild) {
+        srand(9);
+
+        Tools::Vec3 len = {25, 25, 25};
+        vector<Tools::Vec3> centers;
+        vector<Tools::Mat3> rotations;
+        randomGrains(8, len, centers, rotations);
+
+        Polycrystal::Generator b1 =
+            Polycrystal::lattice<Lattice::B1>(LAT_CONST, TYPES);
+
+        Polycrystal::Model model;
+        model.build(centers, rotations, len, b1, 2);
+
+        vector<int> changed = model.rotate(3, rotations[0]);
+        rotations[3] = rotations[0];
+
+        CHECK_EQUAL(1u, changed.size());
+        CHECK_EQUAL(3, changed[0]);
+
+        Polycrystal::Model fresh;
+        fresh.build(centers, rotations, len, b1);
+
+        CHECK_EQUAL(0, mismatches(model, fresh));
+    }
+}
@@ -0,0 +1,117 @@
+#include "UnitTest++/UnitTest++.h"
+#include <cstdint>
+#include <cmath>
+#include "Tools.h"
+#include "Random.h"
+
+using namespace std;
+
+SUITE(philox) {
+    TEST(knownAnswers) {
+        // Reference vectors of the Random123 distribution
+        Random::Block a = Random::philox(Random::Block {{0,0,0,0}}, 0);
+        Random::Block b = Random::philox(Random::Block {{0xffffffff,
+                            0xffffffff, 0xffffffff, 0xffffffff}},
+                            0xffffffffffffffffULL);
+        Random::Block c = Random::philox(Random::Block {{0x243f6a88,
+                            0x85a308d3, 0x13198a2e, 0x03707344}},
+                            0x299f31d0a4093822ULL);
+
+        const uint32_t ea[4] = {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8};
+        const uint32_t eb[4] = {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd};
+        const uint32_t ec[4] = {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1};
+
+        CHECK_ARRAY_EQUAL(ea, a, 4);
+        CHECK_ARRAY_EQUAL(eb, b, 4);
+        CHECK_ARRAY_EQUAL(ec, c, 4);
+    }
+}
+
+SUITE(stream) {
+    TEST(reproducible) {
+        Random::Stream s = Random::stream(42, 3, Random::CENTER);
+        Random::Stream t = Random::stream(42, 3, Random::CENTER);
+
+        for (int i=0; i<10; i++)
+            CHECK_EQUAL(s.next64(), t.next64());
+    }
+
+    TEST(keysAreIndependent) {
+        Random::Stream base = Random::stream(42, 3, Random::CENTER);
+        Random::Stream seed = Random::stream(43, 3, Random::CENTER);
+        Random::Stream grain = Random::stream(42, 4, Random::CENTER);
+        Random::Stream id = Random::stream(42, 3, Random::ORIENTATION);
+
+        uint64_t v = base.next64();
+
+        CHECK(v != seed.next64());
+        CHECK(v != grain.next64());
+        CHECK(v != id.next64());
+    }
+
+    TEST(uniformMoments) {
+        Random::Stream s = Random::stream(1, 0, Random::DECORATION);
+        int n = 100000;
+        double sum = 0, sum2 = 0;
+
+        for (int i=0; i<n; i++) {
+            double u = s.uniform();
+
+            CHECK(u >= 0 && u < 1);
+
+            sum += u;
+            sum2 += u*u;
+        }
+
+        CHECK_CLOSE(0.5, sum/n, 0.005);
+        CHECK_CLOSE(1.0/3, sum2/n, 0.005);
+    }
+}
+
+SUITE(orientation) {
+    TEST(isRotation) {
+        Random::Stream s = Random::stream(5, 0, Random::ORIENTATION);
+
+        for (int i=0; i<20; i++) {
+            Tools::Mat3 R = Random::orientation(s);
+            Tools::Mat3 I = R*Tools::transpose(R);
+
+            CHECK_CLOSE(1, I.r[0].x, 1e-12);
+            CHECK_CLOSE(1, I.r[1].y, 1e-12);
+            CHECK_CLOSE(1, I.r[2].z, 1e-12);
+            CHECK_CLOSE(0, I.r[0].y, 1e-12);
+            CHECK_CLOSE(0, I.r[1].z, 1e-12);
+            CHECK_CLOSE(1, Tools::dot(Tools::cross(R.r[0], R.r[1]), R.r[2]),
+                        1e-12);
+        }
+    }
+
+    TEST(uniformOverRotations) {
+        // For the uniform (Haar) distribution the mean matrix is zero and
+        // the trace 1+2cos(angle) averages to 0 with variance 1
+        int n = 20000;
+        double mean[9] = {0};
+        double trace = 0, trace2 = 0;
+
+        for (int g=0; g<n; g++) {
+            Random::Stream s = Random::stream(9, g, Random::ORIENTATION);
+            Tools::Mat3 R = Random::orientation(s);
+
+            for (int i=0; i<3; i++) {
+                mean[3*i] += R.r[i].x/n;
+                mean[3*i+1] += R.r[i].y/n;
+                mean[3*i+2] += R.r[i].z/n;
+            }
+
+            double t = R.r[0].x + R.r[1].y + R.r[2].z;
+            trace += t/n;
+            trace2 += t*t/n;
+        }
+
+        for (int k=0; k<9; k++)
+            CHECK_CLOSE(0, mean[k], 0.03);
+
+        CHECK_CLOSE(0, trace, 0.05);
+        CHECK_CLOSE(1, trace2, 0.05);
+    }
+}
@@ -0,0 +1,161 @@
+#include "UnitTest++/UnitTest++.h"
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include "Atoms.h"
+#include "Tools.h"
+#include "Regrain.h"
+#include "TestTools.h"
+
+using namespace std;
+using TestTools::rnd;
+
+namespace {
+
+    int nearest(Tools::Vec3 p, const vector<Tools::Vec3> &centers,
+                const Tools::Box &box) {
+        int best = 0;
+
+        for (size_t c=1; c<centers.size(); c++) {
+            if (Tools::norm2(Tools::minImage(p - centers[c], box)) <
+                    Tools::norm2(Tools::minImage(p - centers[best], box)))
+                best = c;
+        }
+
+        return best;
+    }
+
+    int wrongGrains(int nCenters, const Tools::Box &box, int threads) {
+        /* Atoms assigned to another grain than the brute force nearest */
+
+        vector<Tools::Vec3> centers = Regrain::randomCenters(nCenters, box,
+                                                                nCenters);
+        Atoms atoms;
+
+        // Some atoms outside the box, as relaxed structures have them
+        for (int a=0; a<40000; a++) {
+            atoms.push_back(1, box.lo.x + (1.2*rnd() - 0.1)*box.len.x,
+                            box.lo.y + (1.2*rnd() - 0.1)*box.len.y,
+                            box.lo.z + (1.2*rnd() - 0.1)*box.len.z);
+        }
+
+        Regrain::assign(atoms.view(), centers, box, threads);
+
+        int wrong = 0;
+
+        for (size_t a=0; a<atoms.size(); a++) {
+            Tools::Vec3 p = {atoms.x[a], atoms.y[a], atoms.z[a]};
+            wrong += atoms.grain[a] != nearest(p, centers, box);
+        }
+
+        return wrong;
+    }
+}
+
+SUITE(regrain) {
+    TEST(assignMatchesBruteForce) {
+        srand(4);
+
+        Tools::Box box = {Tools::Vec3 {-5, 2, 10}, Tools::Vec3 {20, 30, 25},
+                            0, 0, 0};
+
+        CHECK_EQUAL(0, wrongGrains(1, box, 1));
+        CHECK_EQUAL(0, wrongGrains(10, box, 1));
+        CHECK_EQUAL(0, wrongGrains(200, box, 3));
+
+        // Triclinic boxes take the scan
+        Tools::Box tilted = box;
+        tilted.xy = 4;
+        tilted.yz = -3;
+
+        CHECK_EQUAL(0, wrongGrains(50, tilted, 2));
+    }
+
+    TEST(randomCentersInBox) {
+        Tools::Box box = {Tools::Vec3 {1, 2, 3}, Tools::Vec3 {4, 5, 6}, 0, 0,
+                            0};
+        vector<Tools::Vec3> centers = Regrain::randomCenters(500, box, 9);
+
+        CHECK_EQUAL(500u, centers.size());
+
+        int outside = 0;
+
+        for (size_t c=0; c<centers.size(); c++) {
+            Tools::Vec3 d = centers[c] - box.lo;
+            outside += d.x < 0 || d.y < 0 || d.z < 0 || d.x >= box.len.x ||
+                        d.y >= box.len.y || d.z >= box.len.z;
+        }
+
+        CHECK_EQUAL(0, outside);
+
+        // The same seed gives the same centers
+        CHECK_EQUAL(centers[17].y,
+                    Regrain::randomCenters(20, box, 9)[17].y);
+    }
+
+    TEST(keepAndRetype) {
+        Atoms atoms;
+
+        for (int a=0; a<10; a++) {
+            atoms.push_back(7, a, 0, 0);
+            atoms.grain[a] = a % 4;
+        }
+
+        size_t removed = Regrain::keep(atoms, vector<int> {3, 1});
+
+        CHECK_EQUAL(5u, removed);
+        CHECK_EQUAL(5u, atoms.size());
+        CHECK_EQUAL(1.0, atoms.x[0]);
+        CHECK_EQUAL(3.0, atoms.x[1]);
+        CHECK_EQUAL(9.0, atoms.x[4]);
+
+        Regrain::retype(atoms.view());
+
+        CHECK_EQUAL(2, atoms.type[0]);
+        CHECK_EQUAL(4, atoms.type[1]);
+    }
+
+    TEST(readCenters) {
+        {
+            ofstream out("centersTest.txt");
+            out << "# x y z\n"
+                << "1 2 3\n"
+                << "\n"
+                << "  4.5 -1e-3 6   # last\n";
+        }
+
+        vector<Tools::Vec3> centers = Regrain::readCenters("centersTest.txt");
+
+        CHECK_EQUAL(2u, centers.size());
+        CHECK_EQUAL(3.0, centers[0].z);
+        CHECK_EQUAL(-1e-3, centers[1].y);
+
+        {
+            ofstream out("centersTest.txt");
+            out << "1 2 3\n"
+                << "1 2\n";
+        }
+
+        try {
+            Regrain::readCenters("centersTest.txt");
+            CHECK(false);
+        } catch (const invalid_argument &e) {
+            CHECK(string(e.what()).find("centersTest.txt:2:") == 0);
+        }
+
+        {
+            ofstream out("centersTest.txt");
+            out << "1 2 3 4\n";
+        }
+
+        CHECK_THROW(Regrain::readCenters("centersTest.txt"),
+                    invalid_argument);
+
+        remove("centersTest.txt");
+
+        CHECK_THROW(Regrain::readCenters("noSuchCenters.txt"), runtime_error);
+    }
+}
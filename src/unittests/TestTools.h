@@ -0,0 +1,16 @@
+#ifndef TESTTOOLS_H
+#define TESTTOOLS_H
+
+#include <cstdlib>
+
+// Helpers shared by the unit tests
+namespace TestTools {
+
+    inline double rnd() {
+        /* Uniform in [0, 1], whatever the platform's RAND_MAX */
+
+        return static_cast<double>(rand()) / RAND_MAX;
+    }
+}
+
+#endif
@@ -0,0 +1,144 @@
+#include "UnitTest++/UnitTest++.h"
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include "define.h"
+#include "Atoms.h"
+#include "Tools.h"
+#include "Voronoi.h"
+#include "Grain.h"
+#include "Lattice.h"
+#include "Tiles.h"
+#include "TestTools.h"
+
+using namespace std;
+using TestTools::rnd;
+
+namespace {
+
+    vector<Tools::Vec3> sorted(const AtomView &atoms) {
+        vector<Tools::Vec3> p;
+
+        for (size_t a=0; a<atoms.size(); a++)
+            p.push_back(Tools::Vec3 {atoms.x[a], atoms.y[a], atoms.z[a]});
+
+        sort(p.begin(), p.end(), [](Tools::Vec3 u, Tools::Vec3 v) {
+            if (u.x != v.x) return u.x < v.x;
+            if (u.y != v.y) return u.y < v.y;
+            return u.z < v.z;
+        });
+
+        return p;
+    }
+}
+
+SUITE(layout) {
+    TEST(regionsCoverBox) {
+        vector<Tools::Vec3> centers(1, Tools::Vec3 {5,5,5});
+        Tools::Vec3 len = {10,20,30};
+
+        vector<Voronoi::Cell> cells = Voronoi::computeCells(centers, len);
+        Tiles::Layout layout = Tiles::build(cells, len, 2);
+
+        CHECK_EQUAL(8, layout.count());
+        CHECK_CLOSE(10, layout.width.y, 1e-12);
+
+        Tools::Box last = layout.region(7, Tools::Vec3 {0,0,0});
+
+        CHECK_CLOSE(5, last.lo.x, 1e-12);
+        CHECK_CLOSE(10, last.lo.y, 1e-12);
+        CHECK_CLOSE(15, last.lo.z, 1e-12);
+
+        // A single grain fills the box, so it meets every tile
+        for (int t=0; t<layout.count(); t++)
+            CHECK(!layout.pieces[t].empty());
+    }
+
+    TEST(periodicPieces) {
+        // The cell of a center near the corner sticks out of the box and
+        // meets the far tiles through a shifted image
+        vector<Tools::Vec3> centers;
+        centers.push_back(Tools::Vec3 {0.5,0.5,0.5});
+        centers.push_back(Tools::Vec3 {5,5,5});
+
+        Tools::Vec3 len = {10,10,10};
+        vector<Voronoi::Cell> cells = Voronoi::computeCells(centers, len);
+        Tiles::Layout layout = Tiles::build(cells, len, 4);
+
+        bool shifted = false;
+
+        for (size_t p=0; p<layout.pieces[63].size(); p++) {
+            const Tiles::Piece &piece = layout.pieces[63][p];
+
+            if (piece.grain == 0 && piece.shift.x == -10 &&
+                    piece.shift.y == -10 && piece.shift.z == -10)
+                shifted = true;
+        }
+
+        CHECK(shifted);
+    }
+}
+
+SUITE(tiledGeneration) {
+    TEST(matchesWholeGrains) {
+        srand(21);
+
+        Tools::Vec3 len = {17,17,17};
+        Tools::Box box = {Tools::Vec3 {0,0,0}, len, 0, 0, 0};
+        double latConst = 3.0;
+        const int types[2] = {1, 2};
+
+        vector<Tools::Vec3> centers;
+
+        for (int c=0; c<7; c++) {
+            centers.push_back(Tools::Vec3 {rnd()*len.x, rnd()*len.y,
+                                            rnd()*len.z});
+        }
+
+        vector<Voronoi::Cell> cells = Voronoi::computeCells(centers, len);
+        vector<Tools::Mat3> rot;
+
+        for (int c=0; c<7; c++) {
+            rot.push_back(Tools::rodrigues(rnd()*6, Tools::Vec3 {rnd(), rnd(),
+                                                                rnd()}));
+        }
+
+        Atoms inside, edge;
+
+        for (int g=0; g<7; g++) {
+            Grain::genGrainInCell<Lattice::B1>(inside, edge, cells[g],
+                                                latConst, types, rot[g], box);
+        }
+
+        for (int perAxis=1; perAxis<=3; perAxis++) {
+            Tiles::Layout layout = Tiles::build(cells, len, perAxis);
+            Atoms tInside, tEdge;
+
+            for (int t=0; t<layout.count(); t++) {
+                for (size_t p=0; p<layout.pieces[t].size(); p++) {
+                    const Tiles::Piece &piece = layout.pieces[t][p];
+                    Tools::Box region = layout.region(t, piece.shift);
+
+                    Grain::genGrainInCell<Lattice::B1>(tInside, tEdge,
+                            cells[piece.grain], latConst, types,
+                            rot[piece.grain], box, &region);
+                }
+            }
+
+            CHECK_EQUAL(inside.size(), tInside.size());
+            CHECK_EQUAL(edge.size(), tEdge.size());
+
+            vector<Tools::Vec3> a = sorted(inside.view());
+            vector<Tools::Vec3> b = sorted(tInside.view());
+
+            for (size_t i=0; i<min(a.size(), b.size()); i++)
+                CHECK_CLOSE(0, Tools::norm2(a[i] - b[i]), 1e-16);
+
+            a = sorted(edge.view());
+            b = sorted(tEdge.view());
+
+            for (size_t i=0; i<min(a.size(), b.size()); i++)
+                CHECK_CLOSE(0, Tools::norm2(a[i] - b[i]), 1e-16);
+        }
+    }
+}
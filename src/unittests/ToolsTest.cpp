@@ -266,6 +266,81 @@ SUITE(rotate) {
     }
 }
 
+SUITE(vec3) {
+    TEST(constexprOps) {
+        constexpr Tools::Vec3 a = {1,2,3};
+        constexpr Tools::Vec3 b = {4,5,6};
+        constexpr Tools::Vec3 c = Tools::cross(a, b);
+
+        static_assert(Tools::dot(a, b) == 32, "dot");
+        static_assert(Tools::norm2(a - b) == 27, "norm2");
+
+        CHECK_CLOSE(-3, c.x, tolerance);
+        CHECK_CLOSE(6, c.y, tolerance);
+        CHECK_CLOSE(-3, c.z, tolerance);
+    }
+
+    TEST(matrixProduct) {
+        constexpr Tools::Mat3 A = {{Tools::Vec3 {1,1,1}, Tools::Vec3 {1,1,1},
+                                    Tools::Vec3 {1,1,1}}};
+        constexpr Tools::Mat3 B = {{Tools::Vec3 {2,0,0}, Tools::Vec3 {0,3,0},
+                                    Tools::Vec3 {0,0,4}}};
+        constexpr Tools::Mat3 AB = A*B;
+
+        static_assert(AB.r[1].z == 4, "product");
+
+        Tools::Vec3 v = (Tools::identity()*AB)*Tools::Vec3 {1,0,0};
+
+        CHECK_CLOSE(2, v.x, tolerance);
+        CHECK_CLOSE(2, v.z, tolerance);
+    }
+
+    TEST(rodriguesOrthonormal) {
+        Tools::Mat3 R = Tools::rodrigues(1.3, Tools::Vec3 {0.2,0.7,0.4});
+        Tools::Mat3 RRt = R*Tools::transpose(R);
+
+        CHECK_CLOSE(1, RRt.r[0].x, tolerance);
+        CHECK_CLOSE(0, RRt.r[0].y, tolerance);
+        CHECK_CLOSE(1, RRt.r[2].z, tolerance);
+    }
+
+    TEST(transformMatchesRotateAndShift) {
+        Atoms a1;
+        Atoms a2;
+
+        a1.push_back(1, 1, 2, 3);
+        a1.push_back(1, -1, 0, 2);
+        a2 = a1;
+
+        Tools::Mat3 R = Tools::rodrigues(M_PI/3, Tools::Vec3 {1,0,1});
+        Tools::Vec3 shift = {5,6,7};
+
+        Tools::applyRotation(a1.view(), R);
+        Tools::translate(a1.view(), shift);
+        Tools::transform(a2.view(), R, shift);
+
+        CHECK_ARRAY_CLOSE(a1.x, a2.x, 2, tolerance);
+        CHECK_ARRAY_CLOSE(a1.y, a2.y, 2, tolerance);
+        CHECK_ARRAY_CLOSE(a1.z, a2.z, 2, tolerance);
+    }
+
+    TEST(quaternionMatchesRodrigues) {
+        double t = 0.7;
+        Tools::Vec3 axis = {1,2,2};
+        double s = sin(t/2)/3;
+
+        Tools::Mat3 Q = Tools::quaternion(cos(t/2), s*axis.x, s*axis.y,
+                                            s*axis.z);
+        Tools::Mat3 R = Tools::rodrigues(t, axis);
+
+        for (int i=0; i<3; i++) {
+            CHECK_CLOSE(R.r[i].x, Q.r[i].x, tolerance);
+            CHECK_CLOSE(R.r[i].y, Q.r[i].y, tolerance);
+            CHECK_CLOSE(R.r[i].z, Q.r[i].z, tolerance);
+        }
+    }
+}
+
 int main(int, const char *[]) {
    return UnitTest::RunAllTests();
 }
@@ -0,0 +1,91 @@
+#include "UnitTest++/UnitTest++.h"
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include "define.h"
+#include "Tools.h"
+#include "Grid.h"
+#include "Voronoi.h"
+#include "TestTools.h"
+
+using namespace std;
+using TestTools::rnd;
+
+SUITE(voronoiCells) {
+    TEST(singleCenterFillsBox) {
+        vector<Tools::Vec3> centers;
+        centers.push_back(Tools::Vec3 {2,3,4});
+
+        vector<Voronoi::Cell> cells = Voronoi::computeCells(centers,
+                                                Tools::Vec3 {10,12,14});
+
+        CHECK_EQUAL(1u, cells.size());
+        CHECK_EQUAL(6u, cells[0].faces.size());
+        CHECK_EQUAL(8u, cells[0].vertices.size());
+        CHECK_CLOSE(10*12*14, cells[0].volume, 1e-8);
+        CHECK_CLOSE(-3, cells[0].lo.x, 1e-10);
+        CHECK_CLOSE(11, cells[0].hi.z, 1e-10);
+        CHECK(cells[0].neighbors.empty());
+    }
+
+    TEST(twoCentersSplitBox) {
+        vector<Tools::Vec3> centers;
+        centers.push_back(Tools::Vec3 {2.5,5,5});
+        centers.push_back(Tools::Vec3 {7.5,5,5});
+
+        vector<Voronoi::Cell> cells = Voronoi::computeCells(centers,
+                                                Tools::Vec3 {10,10,10});
+
+        CHECK_CLOSE(500, cells[0].volume, 1e-8);
+        CHECK_CLOSE(500, cells[1].volume, 1e-8);
+        CHECK_CLOSE(0, cells[0].lo.x, 1e-10);
+        CHECK_CLOSE(5, cells[0].hi.x, 1e-10);
+        CHECK_EQUAL(1u, cells[0].neighbors.size());
+        CHECK_EQUAL(1, cells[0].neighbors[0]);
+    }
+
+    TEST(randomCellsTileBox) {
+        srand(3);
+
+        Tools::Vec3 box = {30,20,25};
+        vector<Tools::Vec3> centers;
+
+        for (int c=0; c<60; c++) {
+            centers.push_back(Tools::Vec3 {rnd()*box.x, rnd()*box.y,
+                                            rnd()*box.z});
+        }
+
+        vector<Voronoi::Cell> cells = Voronoi::computeCells(centers, box);
+
+        double total = 0;
+
+        for (size_t c=0; c<cells.size(); c++) {
+            total += cells[c].volume;
+
+            CHECK(Voronoi::contains(cells[c], centers[c]));
+
+            // Adjacency is symmetric
+            for (size_t n=0; n<cells[c].neighbors.size(); n++) {
+                const vector<int> &back = cells[cells[c].neighbors[n]].neighbors;
+                CHECK(binary_search(back.begin(), back.end(),
+                                    static_cast<int>(c)));
+            }
+        }
+
+        CHECK_CLOSE(box.x*box.y*box.z, total, 1e-6);
+
+        // Points near a center's cell agree with the nearest-center lookup
+        CenterGrid grid;
+        grid.build(centers, box);
+
+        for (int n=0; n<2000; n++) {
+            Tools::Vec3 p = {rnd()*box.x, rnd()*box.y, rnd()*box.z};
+            const Voronoi::Cell &cell = cells[grid.nearest(p)];
+
+            Tools::Box pbc = {Tools::Vec3 {0,0,0}, box, 0, 0, 0};
+            Tools::Vec3 q = cell.center + Tools::minImage(p - cell.center, pbc);
+
+            CHECK(Voronoi::contains(cell, q, 1e-9));
+        }
+    }
+}